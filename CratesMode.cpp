@@ -5,8 +5,8 @@
 #include "Sound.hpp"
 #include "MeshBuffer.hpp"
 #include "WalkMesh.hpp"
+#include "RenderDevice.hpp" //where drawing goes (OpenGL, unless recording)
 #include "gl_errors.hpp" //helper for dumpping OpenGL error messages
-#include "read_chunk.hpp" //helper for reading a vector of structures from a file
 #include "data_path.hpp" //helper to get paths relative to executable
 #include "compile_program.hpp" //helper to compile opengl shader programs
 #include "draw_text.hpp" //helper to... um.. draw text
@@ -14,7 +14,6 @@
 
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
-#include <fstream>
 #include <map>
 #include <cstddef>
 #include <random>
@@ -23,7 +22,7 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
 
-static glm::vec3 project_on_plane(glm::vec3 x, glm::vec3 y, glm::vec3 z, glm::vec3 p);
+static glm::vec3 project_on_plane(glm::vec3 origin, glm::vec3 n, glm::vec3 p);
 
 Load< WalkMesh > walk_mesh(LoadTagDefault, [](){
    	return new WalkMesh(data_path("phone-bank-walk.pnc"));
@@ -33,8 +32,12 @@ Load< MeshBuffer > crates_meshes(LoadTagDefault, [](){
 	return new MeshBuffer(data_path("phone-bank.pnc"));
 });
 
-Load< GLuint > crates_meshes_for_vertex_color_program(LoadTagDefault, [](){
-	return new GLuint(crates_meshes->make_vao_for_program(vertex_color_program->program));
+Load< GLuint > crates_meshes_for_vertex_color_block_program(LoadTagDefault, [](){
+	return new GLuint(crates_meshes->make_vao_for_program(vertex_color_block_program->program));
+});
+
+Load< GLuint > crates_meshes_for_vertex_color_instanced_program(LoadTagDefault, [](){
+	return new GLuint(crates_meshes->make_vao_for_program(vertex_color_instanced_program->program, Scene::instance_buffer(), Scene::instance_attribs()));
 });
 
 Load< Sound::Sample > ringtone1(LoadTagDefault, [](){
@@ -72,106 +75,77 @@ CratesMode::CratesMode() {
 	//----------------
 	//set up scene:
 
+	//level is a fairly big hierarchy, so update it in one pass per frame:
+	scene.transform_storage = Scene::TransformStorageFlat;
+	scene.occlusion_culling = true;
+
 	auto attach_object = [this](Scene::Transform *transform, std::string const &name) {
 		Scene::Object *object = scene.new_object(transform);
-		object->program = vertex_color_program->program;
-		object->program_mvp_mat4 = vertex_color_program->object_to_clip_mat4;
-		object->program_mv_mat4x3 = vertex_color_program->object_to_light_mat4x3;
-		object->program_itmv_mat3 = vertex_color_program->normal_to_light_mat3;
-		object->vao = *crates_meshes_for_vertex_color_program;
-		MeshBuffer::Mesh const &mesh = crates_meshes->lookup(name);
-		object->start = mesh.start;
-		object->count = mesh.count;
+		object->program = vertex_color_block_program->program;
+		object->uniform_blocks = true;
+		object->vao = *crates_meshes_for_vertex_color_block_program;
+		object->instanced_program = vertex_color_instanced_program->program;
+		object->instanced_vao = *crates_meshes_for_vertex_color_instanced_program;
+		object->mesh_buffer = crates_meshes.value;
+		object->set_mesh(crates_meshes->lookup(name));
 		return object;
 	};
 
-    {
-        std::ifstream file(data_path("phone-bank.scene"), std::ios::binary);
-
-        std::vector< char > strings;
-        read_chunk(file, "str0", &strings);
-
-        struct TransformData {
-            int parent_ref;
-            uint32_t obj_name_begin, obj_name_end;
-            float pos_x, pos_y, pos_z;
-            float rot_x, rot_y, rot_z, rot_w;
-            float scl_x, scl_y, scl_z;
-        };
-
-        std::vector< TransformData > transforms;
-        read_chunk(file, "xfh0", &transforms);
-
-        std::function< Scene::Transform *(int) > construct_transforms = [&](int ref) -> Scene::Transform *{
-            if (transform_dict.find(ref) != transform_dict.end())
-                return transform_dict[ref];
-
-            TransformData *transform = (TransformData *)(&transforms[ref]);
-            Scene::Transform *new_transform = scene.new_transform();
-            new_transform->position = glm::vec3(transform->pos_x, transform->pos_y, transform->pos_z);
-            new_transform->rotation = glm::quat(transform->rot_w, transform->rot_x, transform->rot_y, transform->rot_z);
-            new_transform->scale = glm::vec3(transform->scl_x, transform->scl_y, transform->scl_z);
-            new_transform->parent = transform->parent_ref < 0 ? nullptr : construct_transforms(transform->parent_ref);
-
-            if (!(transform->obj_name_begin <= transform->obj_name_end && transform->obj_name_end <= strings.size())) {
-                throw std::runtime_error("object scene entry has out-of-range name begin/end");
-            }
-
-            transform_dict[ref] = new_transform;
-            return new_transform;
-        };
-
-        struct MeshData {
-        	int transform_ref;
-        	uint32_t name_begin, name_end;
-        };
-        std::vector< MeshData > sceneObjects;
-        read_chunk(file, "msh0", &sceneObjects);
-
-        uint32_t num_phones = 0;
-        for (auto const &entry : sceneObjects) {
-            if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
-                throw std::runtime_error("mesh scene entry has out-of-range name begin/end");
-            }
-            std::string meshName(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
+	{
+		scene.load(data_path("phone-bank.scene"), [&](Scene::Transform *transform, NameID mesh) -> Scene::Object * {
+			if (mesh == name_id("Phone_Flash") || mesh == name_id("Phone_Interact")) {
+				return nullptr;
+			}
 
-            if (!(entry.transform_ref >= 0 && entry.transform_ref <= (int)transforms.size())) {
-                throw std::runtime_error("mesh scene entry has out of range transform ref");
-            }
+			Scene::Object *object = attach_object(transform, scene.name_string(mesh));
 
-            if (meshName == "Phone_Flash" || meshName == "Phone_Interact") {
-                continue;
+			//the platforms hide most of the level below them:
+			if (mesh == name_id("Circle") || mesh == name_id("Plane")) {
+				scene.add_occluder(object);
 			}
+			return object;
+		});
+
+		//objects are named after their meshes:
+		uint32_t num_phones = 0;
+		for (Scene::Object *object : scene.find_objects(name_id("Phone"))) {
+			assert(num_phones < phone_list.size());
+			PhoneData *phone = phone_list[num_phones];
+			phone->phone_object = object;
+			phone->identifier = num_phones;
+			++num_phones;
+		}
+		assert(num_phones == phone_list.size());
+		phone_state.next_phone = phone_list[3];
+		phone_state.last_phone = phone_list[3];
 
-			Scene::Transform *transform_struct = construct_transforms(entry.transform_ref);
-			Scene::Object *object = attach_object(transform_struct, meshName);
+		player = scene.find_object(name_id("Player"));
 
-			if (meshName == "Phone") {
-				PhoneData *phone = phone_list[num_phones];
-				phone->phone_object = object;
-				phone->identifier = num_phones;
-				++num_phones;
-			}
+		if (player) {
+			player_group = scene.new_transform();
+			player_group->position = player->transform->position;
+			player_group->rotation = player->transform->position;
+			player_group->set_parent(player->transform->parent);
 
-            if (meshName == "Player") {
-                player = object;
-                player_group = scene.new_transform();
-                player_group->position = player->transform->position;
-                player_group->rotation = player->transform->position;
-                player_group->set_parent(player->transform->parent);
+			player->transform->position = glm::vec3(0.0f, 0.0f, 0.0f);
+			player->transform->rotation = glm::quat();
+			player->transform->set_parent(player_group);
 
-                player->transform->position = glm::vec3(0.0f, 0.0f, 0.0f);
-                player->transform->rotation = glm::quat();
-                player->transform->set_parent(player_group);
+			wp = walk_mesh->start(player_group->position);
+			player_group->position = walk_mesh->world_point(wp);
+		}
 
-                wp = walk_mesh->start(player_group->position);
-                player_group->position = walk_mesh->world_point(wp);
-            }
-        }
-        assert(phone_list.size() == 4);
-        phone_state.next_phone = phone_list[3];
-        phone_state.last_phone = phone_list[3];
-    }
+		//everything but the player and the phones (which swap meshes) stays put, so bake it into a few big draws,
+		// chunked so that what is under the platforms can still be occlusion culled:
+		auto keep_dynamic = [this](Scene::Object const *object) {
+			if (object == player) return true;
+			for (PhoneData const *phone : phone_list) {
+				if (phone->phone_object == object) return true;
+			}
+			return false;
+		};
+		scene.bake_static(nullptr, keep_dynamic, LEVEL_CHUNK_SIZE);
+	}
 
 	{
 	    //Camera looking at the origin:
@@ -400,16 +374,14 @@ void CratesMode::update(float elapsed) {
     };
 
 	auto can_interact = [&](PhoneData *phone) -> bool {
-		glm::vec3 x = walk_mesh->vertices[wp.triangle.x];
-		glm::vec3 y = walk_mesh->vertices[wp.triangle.y];
-		glm::vec3 z = walk_mesh->vertices[wp.triangle.z];
-		glm::vec3 player_to_phone = project_on_plane(x, y, z, phone->phone_object->transform->position)
+		WalkMesh::TriangleFrame const &frame = walk_mesh->triangle_frames[wp.triangle];
+		glm::vec3 player_to_phone = project_on_plane(frame.origin, frame.normal, phone->phone_object->transform->position)
 									- player_group->position;
 		float distance = glm::length(player_to_phone);
 		glm::mat4 cam_to_world = glm::mat4_cast(player_group->rotation * camera->transform->rotation);
 
-		glm::vec3 player_forward = project_on_plane(x, y, z, -cam_to_world[2]);
-		player_forward = project_on_plane(x, y, z, player_forward);
+		glm::vec3 player_forward = project_on_plane(frame.origin, frame.normal, -cam_to_world[2]);
+		player_forward = project_on_plane(frame.origin, frame.normal, player_forward);
 
 		float dot = glm::dot(glm::normalize(player_to_phone), player_forward);
 		return distance <= INTERACT_RADIUS && dot >= INTERACT_DOT;
@@ -472,17 +444,11 @@ void CratesMode::update(float elapsed) {
 	    phone->last_ring += elapsed;
 
 	    if (phone->can_interact) {
-			MeshBuffer::Mesh const &mesh = crates_meshes->lookup("Phone_Interact");
-			phone->phone_object->start = mesh.start;
-			phone->phone_object->count = mesh.count;
+			phone->phone_object->set_mesh(crates_meshes->lookup("Phone_Interact"));
 	    } else if (phone->is_active) {
-			MeshBuffer::Mesh const &mesh = crates_meshes->lookup("Phone_Flash");
-			phone->phone_object->start = mesh.start;
-			phone->phone_object->count = mesh.count;
+			phone->phone_object->set_mesh(crates_meshes->lookup("Phone_Flash"));
 		} else {
-			MeshBuffer::Mesh const &mesh = crates_meshes->lookup("Phone");
-			phone->phone_object->start = mesh.start;
-			phone->phone_object->count = mesh.count;
+			phone->phone_object->set_mesh(crates_meshes->lookup("Phone"));
 		}
 
         if (phone->is_active &&  phone->last_ring > RING_DURATION) {
@@ -517,41 +483,49 @@ void CratesMode::update(float elapsed) {
 	}
 }
 
-void CratesMode::draw(glm::uvec2 const &drawable_size) {
-	//set up basic OpenGL state:
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void CratesMode::sync() {
+	//set up light position + color (uploaded with the scene's frame block):
+	scene.frame_block.sun_color = glm::vec4(0.81f, 0.81f, 0.76f, 0.0f);
+	scene.frame_block.sun_direction = glm::vec4(glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f)), 0.0f);
+	scene.frame_block.sky_color = glm::vec4(0.4f, 0.4f, 0.45f, 0.0f);
+	scene.frame_block.sky_direction = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
 
-	//set up light position + color:
-	glUseProgram(vertex_color_program->program);
-	glUniform3fv(vertex_color_program->sun_color_vec3, 1, glm::value_ptr(glm::vec3(0.81f, 0.81f, 0.76f)));
-	glUniform3fv(vertex_color_program->sun_direction_vec3, 1, glm::value_ptr(glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f))));
-	glUniform3fv(vertex_color_program->sky_color_vec3, 1, glm::value_ptr(glm::vec3(0.4f, 0.4f, 0.45f)));
-	glUniform3fv(vertex_color_program->sky_direction_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 1.0f, 0.0f)));
-	glUseProgram(0);
+	scene.snapshot(camera);
+
+	hud.speaking = speaking;
+	hud.mission = mission;
+	hud.try_mission = try_mission;
+	hud.codeword = codeword;
+	hud.selected_codeword = selected_codeword;
+}
 
-	//fix aspect ratio of camera
-	camera->aspect = drawable_size.x / float(drawable_size.y);
+void CratesMode::draw(glm::uvec2 const &drawable_size) {
+	RenderDevice &device = *RenderDevice::current;
+
+	//set up basic OpenGL state:
+	device.enable(GL_DEPTH_TEST);
+	device.enable(GL_BLEND);
+	device.blend_equation(GL_FUNC_ADD);
+	device.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	scene.draw(camera);
+	//draw the scene as of the last sync() (with the current aspect ratio):
+	scene.draw_snapshot(drawable_size.x / float(drawable_size.y));
 
 	if (Mode::current.get() == this) {
-		glDisable(GL_DEPTH_TEST);
+		device.disable(GL_DEPTH_TEST);
 		std::string message;
 
-		if (speaking) {
+		if (hud.speaking) {
             float height = 0.08f;
             GLint viewport[4];
-            glGetIntegerv(GL_VIEWPORT, viewport);
+            device.get_viewport(viewport);
             float aspect = viewport[2] / float(viewport[3]);
-		    if (!try_mission && !mission) {
+		    if (!hud.try_mission && !hud.mission) {
 		        std::string prompt = "JUST CHECKING IN";
 				message = "SPACE TO CONTINUE";
                 draw_text(prompt, glm::vec2(-aspect + 0.1f, 0.9f - height), height, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
-		    } else if (!try_mission && mission){
-				std::string prompt1 = "SAY " + codewords_list[codeword] + " TO THE PHONE";
+		    } else if (!hud.try_mission && hud.mission){
+				std::string prompt1 = "SAY " + codewords_list[hud.codeword] + " TO THE PHONE";
 				std::string prompt2 = "ON THE FAR PLATFORM";
 				message = "SPACE TO CONTINUE";
                 draw_text(prompt1, glm::vec2(-aspect + 0.1f, 0.9f - height), height, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
@@ -561,7 +535,7 @@ void CratesMode::draw(glm::uvec2 const &drawable_size) {
                 draw_text(prompt, glm::vec2(-aspect + 0.1f, 0.9f - height), height, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
 
                 for (uint32_t i = 0; i < codewords_list.size(); ++i) {
-                    std::string preamble = i == selected_codeword ? "*" : " ";
+                    std::string preamble = i == hud.selected_codeword ? "*" : " ";
                     std::string option = preamble + codewords_list[i];
 
                     draw_text(option, glm::vec2(-aspect + 0.2f, 0.9f - (i+2) * height - ((i+1) * 0.05f)),
@@ -582,7 +556,7 @@ void CratesMode::draw(glm::uvec2 const &drawable_size) {
 		draw_text(message, glm::vec2(-0.5f * width,-0.99f), height, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f));
 		draw_text(message, glm::vec2(-0.5f * width,-1.0f), height, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
 
-		glUseProgram(0);
+		device.use_program(0);
 	}
 
 	GL_ERRORS();
@@ -609,11 +583,8 @@ void CratesMode::show_pause_menu() {
 }
 
 //Code from https://stackoverflow.com/questions/9605556/how-to-project-a-point-onto-a-plane-in-3d
-static glm::vec3 project_on_plane(glm::vec3 x, glm::vec3 y, glm::vec3 z, glm::vec3 p) {
-    glm::vec3 v0 = y - x;
-    glm::vec3 v1 = z - x;
-    glm::vec3 v2 = p - x;
-    glm::vec3 n = glm::normalize(glm::cross(v0, v1));
-    float dist = glm::dot(v2, n);
+//(n is the plane's unit normal)
+static glm::vec3 project_on_plane(glm::vec3 origin, glm::vec3 n, glm::vec3 p) {
+    float dist = glm::dot(p - origin, n);
     return p - dist * n;
 }
\ No newline at end of file
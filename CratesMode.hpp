@@ -21,6 +21,9 @@ static float const RING_DURATION = 15.0f;
 static float const INTERACT_RADIUS = 2.5f;
 static float const INTERACT_DOT = 0.8f;
 
+//the level is baked in cubes this wide (about a platform's radius, so railings under a platform aren't merged with ones on it):
+static float const LEVEL_CHUNK_SIZE = 4.0f;
+
 // The 'CratesMode' shows scene with some crates in it:
 
 struct CratesMode : public Mode {
@@ -38,6 +41,10 @@ struct CratesMode : public Mode {
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) override;
 
+	//update runs alongside draw; sync copies what draw reads (scene snapshot + 'hud', below):
+	virtual bool overlap_update() const override { return true; }
+	virtual void sync() override;
+
 	//starts up a 'quit/resume' pause menu:
 	void show_pause_menu();
 
@@ -60,7 +67,6 @@ struct CratesMode : public Mode {
 	Scene scene;
 	Scene::Camera *camera = nullptr;
 
-    std::map< int, Scene::Transform * > transform_dict;
     Scene::Object *player = nullptr;
 
     WalkPoint wp;
@@ -107,6 +113,15 @@ struct CratesMode : public Mode {
     uint32_t selected_codeword = 0;
     std::vector< std::string > const codewords_list = {"HERON", "DOG", "FISH", "MONKEY", "BIRD"};
 
+    //copy of the above for draw (made by sync, since update may be changing them while draw runs):
+    struct {
+        bool speaking = false;
+        bool mission = false;
+        bool try_mission = false;
+        uint32_t codeword = -1;
+        uint32_t selected_codeword = 0;
+    } hud;
+
 	//when this reaches zero, the 'dot' sample is triggered at the small crate:
 	float dot_countdown = 1.0f;
 
@@ -4,6 +4,7 @@
 #include "MenuMode.hpp"
 #include "Load.hpp"
 #include "MeshBuffer.hpp"
+#include "RenderDevice.hpp" //where drawing goes (OpenGL, unless recording)
 #include "gl_errors.hpp" //helper for dumpping OpenGL error messages
 #include "read_chunk.hpp" //helper for reading a vector of structures from a file
 #include "data_path.hpp" //helper to get paths relative to executable
@@ -145,11 +146,13 @@ void GameMode::update(float elapsed) {
 }
 
 void GameMode::draw(glm::uvec2 const &drawable_size) {
+	RenderDevice &device = *RenderDevice::current;
+
 	//set up basic OpenGL state:
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	device.enable(GL_DEPTH_TEST);
+	device.enable(GL_BLEND);
+	device.blend_equation(GL_FUNC_ADD);
+	device.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	//Set up a transformation matrix to fit the board in the window:
 	glm::mat4 world_to_clip;
@@ -175,32 +178,32 @@ void GameMode::draw(glm::uvec2 const &drawable_size) {
 	}
 
 	//set up graphics pipeline to use data from the meshes and the simple shading program:
-	glBindVertexArray(*meshes_for_vertex_color_program);
-	glUseProgram(vertex_color_program->program);
+	device.bind_vertex_array(*meshes_for_vertex_color_program);
+	device.use_program(vertex_color_program->program);
 
-	glUniform3fv(vertex_color_program->sun_color_vec3, 1, glm::value_ptr(glm::vec3(0.81f, 0.81f, 0.76f)));
-	glUniform3fv(vertex_color_program->sun_direction_vec3, 1, glm::value_ptr(glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f))));
-	glUniform3fv(vertex_color_program->sky_color_vec3, 1, glm::value_ptr(glm::vec3(0.2f, 0.2f, 0.3f)));
-	glUniform3fv(vertex_color_program->sky_direction_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 1.0f, 0.0f)));
+	device.uniform(vertex_color_program->sun_color_vec3, glm::vec3(0.81f, 0.81f, 0.76f));
+	device.uniform(vertex_color_program->sun_direction_vec3, glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f)));
+	device.uniform(vertex_color_program->sky_color_vec3, glm::vec3(0.2f, 0.2f, 0.3f));
+	device.uniform(vertex_color_program->sky_direction_vec3, glm::vec3(0.0f, 1.0f, 0.0f));
 
 	//helper function to draw a given mesh with a given transformation:
 	auto draw_mesh = [&](MeshBuffer::Mesh const &mesh, glm::mat4 const &object_to_world) {
 		//set up the matrix uniforms:
 		if (vertex_color_program->object_to_clip_mat4 != -1U) {
 			glm::mat4 object_to_clip = world_to_clip * object_to_world;
-			glUniformMatrix4fv(vertex_color_program->object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+			device.uniform(vertex_color_program->object_to_clip_mat4, object_to_clip);
 		}
 		if (vertex_color_program->object_to_light_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(vertex_color_program->object_to_light_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_world));
+			device.uniform(vertex_color_program->object_to_light_mat4x3, glm::mat4x3(object_to_world));
 		}
 		if (vertex_color_program->normal_to_light_mat3 != -1U) {
 			//NOTE: if there isn't any non-uniform scaling in the object_to_world matrix, then the inverse transpose is the matrix itself, and computing it wastes some CPU time:
 			glm::mat3 normal_to_world = glm::inverse(glm::transpose(glm::mat3(object_to_world)));
-			glUniformMatrix3fv(vertex_color_program->normal_to_light_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_world));
+			device.uniform(vertex_color_program->normal_to_light_mat3, normal_to_world);
 		}
 
 		//draw the mesh:
-		glDrawArrays(GL_TRIANGLES, mesh.start, mesh.count);
+		device.draw_arrays(GL_TRIANGLES, mesh.start, mesh.count);
 	};
 
 	for (uint32_t y = 0; y < board_size.y; ++y) {
@@ -234,14 +237,14 @@ void GameMode::draw(glm::uvec2 const &drawable_size) {
 	);
 
 	if (Mode::current.get() == this) {
-		glDisable(GL_DEPTH_TEST);
+		device.disable(GL_DEPTH_TEST);
 		std::string message = "PRESS ESC FOR MENU";
 		float height = 0.06f;
 		float width = text_width(message, height);
 		draw_text(message, glm::vec2(-0.5f * width,-0.99f), height, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f));
 		draw_text(message, glm::vec2(-0.5f * width,-1.0f), height, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
 
-		glUseProgram(0);
+		device.use_program(0);
 	}
 
 	GL_ERRORS();
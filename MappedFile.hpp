@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+//"MappedFile" maps a whole file, read-only, into memory for as long as it exists:
+//   MappedFile file(data_path("level.scene"));
+//   parse(file.data, file.size);
+// note: will throw if the file can't be opened or mapped.
+struct MappedFile {
+	MappedFile(std::string const &filename);
+	MappedFile(MappedFile const &) = delete;
+	~MappedFile();
+
+	uint8_t const *data = nullptr; //(nullptr for an empty file)
+	size_t size = 0;
+
+private:
+#if defined(_WIN32)
+	void *file = nullptr; //HANDLEs
+	void *mapping = nullptr;
+#endif
+};
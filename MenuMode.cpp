@@ -4,6 +4,7 @@
 #include "compile_program.hpp"
 #include "MeshBuffer.hpp"
 #include "data_path.hpp"
+#include "RenderDevice.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 #include <cmath>
@@ -113,22 +114,24 @@ void MenuMode::update(float elapsed) {
 }
 
 void MenuMode::draw(glm::uvec2 const &drawable_size) {
+	RenderDevice &device = *RenderDevice::current;
+
 	if (background && background_fade < 1.0f) {
 		background->draw(drawable_size);
 
-		glDisable(GL_DEPTH_TEST);
+		device.disable(GL_DEPTH_TEST);
 		if (background_fade > 0.0f) {
-			glEnable(GL_BLEND);
-			glBlendEquation(GL_FUNC_ADD);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUseProgram(*fade_program);
-			glUniform4fv(fade_program_color, 1, glm::value_ptr(glm::vec4(0.0f, 0.0f, 0.0f, background_fade)));
-			glDrawArrays(GL_TRIANGLES, 0, 3);
-			glUseProgram(0);
-			glDisable(GL_BLEND);
+			device.enable(GL_BLEND);
+			device.blend_equation(GL_FUNC_ADD);
+			device.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			device.use_program(*fade_program);
+			device.uniform(fade_program_color, glm::vec4(0.0f, 0.0f, 0.0f, background_fade));
+			device.draw_arrays(GL_TRIANGLES, 0, 3);
+			device.use_program(0);
+			device.disable(GL_BLEND);
 		}
 	}
-	glDisable(GL_DEPTH_TEST);
+	device.disable(GL_DEPTH_TEST);
 
 	float aspect = drawable_size.x / float(drawable_size.y);
 	//scale factors such that a rectangle of aspect 'aspect' and height '1.0' fills the window:
@@ -145,8 +148,8 @@ void MenuMode::draw(glm::uvec2 const &drawable_size) {
 		total_height += choice.height + 2.0f * choice.padding;
 	}
 
-	glUseProgram(*menu_program);
-	glBindVertexArray(*menu_binding);
+	device.use_program(*menu_program);
+	device.bind_vertex_array(*menu_binding);
 
 	//character width and spacing helpers:
 	// (...in terms of the menu font's default 3-unit height)
@@ -198,11 +201,11 @@ void MenuMode::draw(glm::uvec2 const &drawable_size) {
 					glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
 					glm::vec4(s * x, y, 0.0f, 1.0f)
 				);
-				glUniformMatrix4fv(menu_program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
-				glUniform3f(menu_program_color, 1.0f, 1.0f, 1.0f);
+				device.uniform(menu_program_mvp, mvp);
+				device.uniform(menu_program_color, glm::vec3(1.0f, 1.0f, 1.0f));
 
 				MeshBuffer::Mesh const &mesh = menu_meshes->lookup(label.substr(i,1));
-				glDrawArrays(GL_TRIANGLES, mesh.start, mesh.count);
+				device.draw_arrays(GL_TRIANGLES, mesh.start, mesh.count);
 			}
 
 			x += width(label[i]);
@@ -211,5 +214,5 @@ void MenuMode::draw(glm::uvec2 const &drawable_size) {
 		y -= choice.padding;
 	}
 
-	glEnable(GL_DEPTH_TEST);
+	device.enable(GL_DEPTH_TEST);
 }
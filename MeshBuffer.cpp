@@ -10,6 +10,9 @@
 #include <string>
 #include <set>
 #include <cstddef>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
 
 MeshBuffer::MeshBuffer(std::string const &filename) {
 	glGenBuffers(1, &vbo);
@@ -17,6 +20,7 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	std::ifstream file(filename, std::ios::binary);
 
 	GLuint total = 0;
+	std::vector< glm::vec3 > positions; //kept long enough to compute mesh bounds
 	//read + upload data chunk:
 	if (filename.size() >= 2 && filename.substr(filename.size()-2) == ".p") {
 		struct Vertex {
@@ -34,6 +38,13 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 
 		total = GLuint(data.size()); //store total for later checks on index
 
+		vertex_data.assign(reinterpret_cast< uint8_t const * >(data.data()), reinterpret_cast< uint8_t const * >(data.data() + data.size()));
+
+		positions.reserve(data.size());
+		for (auto const &v : data) {
+			positions.emplace_back(v.Position);
+		}
+
 		//store attrib locations:
 		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
 
@@ -54,6 +65,13 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 
 		total = GLuint(data.size()); //store total for later checks on index
 
+		vertex_data.assign(reinterpret_cast< uint8_t const * >(data.data()), reinterpret_cast< uint8_t const * >(data.data() + data.size()));
+
+		positions.reserve(data.size());
+		for (auto const &v : data) {
+			positions.emplace_back(v.Position);
+		}
+
 		//store attrib locations:
 		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
 		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
@@ -76,6 +94,13 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 
 		total = GLuint(data.size()); //store total for later checks on index
 
+		vertex_data.assign(reinterpret_cast< uint8_t const * >(data.data()), reinterpret_cast< uint8_t const * >(data.data() + data.size()));
+
+		positions.reserve(data.size());
+		for (auto const &v : data) {
+			positions.emplace_back(v.Position);
+		}
+
 		//store attrib locations:
 		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
 		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
@@ -100,6 +125,13 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 
 		total = GLuint(data.size()); //store total for later checks on index
 
+		vertex_data.assign(reinterpret_cast< uint8_t const * >(data.data()), reinterpret_cast< uint8_t const * >(data.data() + data.size()));
+
+		positions.reserve(data.size());
+		for (auto const &v : data) {
+			positions.emplace_back(v.Position);
+		}
+
 		//store attrib locations:
 		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
 		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
@@ -123,6 +155,14 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		std::vector< IndexEntry > index;
 		read_chunk(file, "idx0", &index);
 
+		//entries named '<name>.lod<level>' are attached to mesh '<name>' once all entries are read:
+		struct LOD {
+			std::string base;
+			uint32_t level;
+			Mesh::Range range;
+		};
+		std::vector< LOD > lods;
+
 		for (auto const &entry : index) {
 			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
 				throw std::runtime_error("index entry has out-of-range name begin/end");
@@ -134,10 +174,53 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 			Mesh mesh;
 			mesh.start = entry.vertex_begin;
 			mesh.count = entry.vertex_end - entry.vertex_begin;
+			if (mesh.count) {
+				//box from min/max, sphere centered on the box:
+				mesh.min = mesh.max = positions[mesh.start];
+				for (GLuint i = mesh.start; i < mesh.start + mesh.count; ++i) {
+					mesh.min = glm::min(mesh.min, positions[i]);
+					mesh.max = glm::max(mesh.max, positions[i]);
+				}
+				mesh.center = 0.5f * (mesh.min + mesh.max);
+				float radius2 = 0.0f;
+				for (GLuint i = mesh.start; i < mesh.start + mesh.count; ++i) {
+					glm::vec3 d = positions[i] - mesh.center;
+					radius2 = std::max(radius2, glm::dot(d, d));
+				}
+				mesh.radius = std::sqrt(radius2);
+			}
 			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
 			if (!inserted) {
 				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
 			}
+
+			std::string::size_type dot = name.rfind(".lod");
+			if (dot != std::string::npos && dot + 4 < name.size()
+			 && name.find_first_not_of("0123456789", dot + 4) == std::string::npos) {
+				LOD lod;
+				lod.base = name.substr(0, dot);
+				lod.level = uint32_t(std::stoul(name.substr(dot + 4)));
+				lod.range.start = mesh.start;
+				lod.range.count = mesh.count;
+				lods.emplace_back(lod);
+			}
+		}
+
+		std::stable_sort(lods.begin(), lods.end(), [](LOD const &a, LOD const &b) {
+			return a.level < b.level;
+		});
+		for (auto const &lod : lods) {
+			auto f = meshes.find(lod.base);
+			if (f == meshes.end()) {
+				std::cerr << "WARNING: level of detail " << lod.level << " of mesh '" << lod.base << "' in filename '" << filename << "' has no base mesh." << std::endl;
+				continue;
+			}
+			//levels are stored by position, so they must run 1, 2, 3, ... (sorted above) without gaps or repeats:
+			uint32_t expected = uint32_t(f->second.lods.size()) + 1;
+			if (lod.level != expected) {
+				throw std::runtime_error("mesh '" + lod.base + "' in filename '" + filename + "' has level of detail " + std::to_string(lod.level) + " where level " + std::to_string(expected) + " was expected (levels must be numbered 1, 2, 3, ... with none missing or repeated)");
+			}
+			f->second.lods.emplace_back(lod.range);
 		}
 	}
 
@@ -156,6 +239,14 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	*/
 }
 
+MeshBuffer::MeshBuffer(MeshBuffer const &layout, std::vector< uint8_t > const &data) : Position(layout.Position), Normal(layout.Normal), Color(layout.Color), TexCoord(layout.TexCoord), vertex_data(data) {
+	assert(layout.Position.stride > 0 && data.size() % layout.Position.stride == 0 && "data should hold whole vertices");
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 const MeshBuffer::Mesh &MeshBuffer::lookup(std::string const &name) const {
 	auto f = meshes.find(name);
 	if (f == meshes.end()) {
@@ -165,6 +256,10 @@ const MeshBuffer::Mesh &MeshBuffer::lookup(std::string const &name) const {
 }
 
 GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
+	return make_vao_for_program(program, 0, std::vector< InstanceAttrib >());
+}
+
+GLuint MeshBuffer::make_vao_for_program(GLuint program, GLuint instance_vbo, std::vector< InstanceAttrib > const &instance_attribs) const {
 	//create a new vertex array object:
 	GLuint vao = 0;
 	glGenVertexArrays(1, &vao);
@@ -188,6 +283,27 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	bind_attribute("Normal", Normal);
 	bind_attribute("Color", Color);
 	bind_attribute("TexCoord", TexCoord);
+
+	//per-instance attributes, if any:
+	if (!instance_attribs.empty()) {
+		assert(instance_vbo != 0 && "instance attributes need a buffer to read from");
+		glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+		for (auto const &ia : instance_attribs) {
+			GLint location = glGetAttribLocation(program, ia.name.c_str());
+			if (location == -1) {
+				std::cerr << "WARNING: instance attribute '" << ia.name << "' isn't active in program." << std::endl;
+				continue;
+			}
+			for (GLuint c = 0; c < ia.columns; ++c) {
+				GLsizei offset = ia.attrib.offset + GLsizei(c * ia.attrib.size * sizeof(float));
+				glVertexAttribPointer(location + c, ia.attrib.size, ia.attrib.type, ia.attrib.normalized, ia.attrib.stride, (GLbyte *)0 + offset);
+				glEnableVertexAttribArray(location + c);
+				glVertexAttribDivisor(location + c, 1);
+			}
+			bound.insert(location);
+		}
+	}
+
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 
@@ -1,7 +1,12 @@
 #pragma once
 
 #include "GL.hpp"
+
+#include <glm/glm.hpp>
+
 #include <map>
+#include <string>
+#include <vector>
 
 //"MeshBuffer" holds a collection of meshes loaded from a file
 // (note that meshes in a single collection will share a vbo/vao)
@@ -33,11 +38,26 @@ struct MeshBuffer {
 	// note: will throw if file fails to read.
 	MeshBuffer(std::string const &filename);
 
+	//construct from vertex data with the same layout (attribs) as another buffer:
+	// (starts with no meshes -- add them to 'meshes' directly)
+	MeshBuffer(MeshBuffer const &layout, std::vector< uint8_t > const &data);
+
 	//look up a particular mesh in the DB:
 	// note: will throw if mesh not found.
 	struct Mesh {
 		GLuint start = 0;
 		GLuint count = 0;
+		//bounds of the mesh's vertex positions (computed at load time):
+		glm::vec3 min = glm::vec3(0.0f); //axis-aligned box
+		glm::vec3 max = glm::vec3(0.0f);
+		glm::vec3 center = glm::vec3(0.0f); //sphere
+		float radius = 0.0f;
+		//reduced levels of detail, coarsest last (from entries named '<name>.lod1', '<name>.lod2', ...; loading throws if a level is missing or repeated):
+		struct Range {
+			GLuint start = 0;
+			GLuint count = 0;
+		};
+		std::vector< Range > lods;
 	};
 	const Mesh &lookup(std::string const &name) const;
 	
@@ -46,6 +66,19 @@ struct MeshBuffer {
 	//  and warn if this buffer contains attributes not active in the program
 	GLuint make_vao_for_program(GLuint program) const;
 
+	//build a vertex array object that also reads per-instance attributes (divisor 1) from 'instance_vbo':
+	// matrix attributes are described by their first column, with 'columns' giving the column count
+	// (columns are assumed to be tightly packed floats)
+	struct InstanceAttrib {
+		std::string name;
+		Attrib attrib;
+		GLuint columns = 1;
+		InstanceAttrib(std::string const &name_, Attrib const &attrib_, GLuint columns_ = 1)
+		: name(name_), attrib(attrib_), columns(columns_) { }
+	};
+	GLuint make_vao_for_program(GLuint program, GLuint instance_vbo, std::vector< InstanceAttrib > const &instance_attribs) const;
+
 	//internals:
 	std::map< std::string, Mesh > meshes;
+	std::vector< uint8_t > vertex_data; //copy of the buffer's contents, for CPU-side processing (e.g. Scene::bake_static)
 };
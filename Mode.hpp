@@ -21,6 +21,14 @@ public:
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//overlapped updates (optional):
+	// if overlap_update() returns true, update() for the next frame runs on another thread while draw() runs,
+	// and sync() is called on the main thread -- with neither running -- before the first overlapped update and after each one.
+	// sync() should copy whatever draw() reads (e.g. with Scene::snapshot) so draw() never reads state update() writes;
+	// update() must then also leave Mode::current alone (handle_event and sync still run on the main thread and may change it).
+	virtual bool overlap_update() const { return false; }
+	virtual void sync() { }
+
 	//Mode::current is the Mode to which events are dispatched.
 	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
 	static std::shared_ptr< Mode > current;
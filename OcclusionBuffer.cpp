@@ -0,0 +1,229 @@
+#include "OcclusionBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_BUFFER_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+//four floats, one per pixel in a row of four:
+struct Lanes {
+#ifdef OCCLUSION_BUFFER_SSE
+	__m128 v;
+#else
+	float v[4];
+#endif
+};
+
+#ifdef OCCLUSION_BUFFER_SSE
+inline Lanes splat(float f) { return Lanes{_mm_set1_ps(f)}; }
+inline Lanes lanes(float a, float b, float c, float d) { return Lanes{_mm_setr_ps(a, b, c, d)}; }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{_mm_add_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{_mm_mul_ps(a.v, b.v)}; }
+//write max(at, value) to 'at' in lanes where all of e0, e1, e2 are non-negative:
+inline void store_inside(float *at, Lanes value, Lanes e0, Lanes e1, Lanes e2) {
+	__m128 zero = _mm_setzero_ps();
+	__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0.v, zero), _mm_cmpge_ps(e1.v, zero)), _mm_cmpge_ps(e2.v, zero));
+	if (_mm_movemask_ps(inside) == 0) return;
+	__m128 old = _mm_loadu_ps(at);
+	__m128 nearer = _mm_max_ps(old, value.v);
+	_mm_storeu_ps(at, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+}
+#else
+inline Lanes splat(float f) { return Lanes{{f, f, f, f}}; }
+inline Lanes lanes(float a, float b, float c, float d) { return Lanes{{a, b, c, d}}; }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{{a.v[0]+b.v[0], a.v[1]+b.v[1], a.v[2]+b.v[2], a.v[3]+b.v[3]}}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{{a.v[0]*b.v[0], a.v[1]*b.v[1], a.v[2]*b.v[2], a.v[3]*b.v[3]}}; }
+inline void store_inside(float *at, Lanes value, Lanes e0, Lanes e1, Lanes e2) {
+	for (uint32_t l = 0; l < 4; ++l) {
+		if (e0.v[l] >= 0.0f && e1.v[l] >= 0.0f && e2.v[l] >= 0.0f) {
+			at[l] = std::max(at[l], value.v[l]);
+		}
+	}
+}
+#endif
+
+//smallest w a vertex may have and still be rasterized (or a box corner and still be tested):
+float const MinW = 1e-5f;
+
+//boxes must be nearer than the pyramid by this (relative) margin to count as occluded,
+// so an occluder's own faces -- which lie on its bounding box -- don't hide it through rounding:
+float const OccludedMargin = 1e-3f;
+
+//screen-space vertex: pixel coordinates and 1/w:
+struct ScreenVertex {
+	float x, y, inv_w;
+};
+
+//edge function a*x + b*y + c, positive to the left of the edge from v0 to v1:
+struct Edge {
+	float a, b, c;
+	Edge(ScreenVertex const &v0, ScreenVertex const &v1)
+		: a(v0.y - v1.y), b(v1.x - v0.x), c(v0.x * v1.y - v0.y * v1.x) { }
+	float at(float x, float y) const { return a * x + b * y + c; }
+};
+
+} //end anon namespace
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) {
+	assert(width > 0 && height > 0);
+	Level level;
+	level.width = (width + 3U) & ~3U;
+	level.height = height;
+	levels.emplace_back(level);
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		Level const &below = levels.back();
+		level.width = std::max(1U, (below.width + 1U) / 2U);
+		level.height = std::max(1U, (below.height + 1U) / 2U);
+		levels.emplace_back(level);
+	}
+	for (auto &l : levels) {
+		l.depth.assign(l.width * l.height, 0.0f);
+	}
+}
+
+void OcclusionBuffer::clear() {
+	for (auto &level : levels) {
+		std::fill(level.depth.begin(), level.depth.end(), 0.0f);
+	}
+}
+
+void OcclusionBuffer::rasterize_triangles(glm::mat4 const &object_to_clip, uint8_t const *positions, uint32_t stride, uint32_t vertex_count) {
+	assert(vertex_count % 3 == 0);
+	Level &target = levels[0];
+	float width = float(target.width);
+	float height = float(target.height);
+
+	for (uint32_t t = 0; t + 3 <= vertex_count; t += 3) {
+		ScreenVertex v[3];
+		bool behind = false;
+		for (uint32_t i = 0; i < 3; ++i) {
+			glm::vec3 position;
+			std::memcpy(&position, positions + (t + i) * stride, sizeof(position));
+			glm::vec4 clip = object_to_clip * glm::vec4(position, 1.0f);
+			if (clip.w < MinW) {
+				behind = true;
+				break;
+			}
+			v[i].inv_w = 1.0f / clip.w;
+			v[i].x = (clip.x * v[i].inv_w * 0.5f + 0.5f) * width;
+			v[i].y = (clip.y * v[i].inv_w * 0.5f + 0.5f) * height;
+		}
+		if (behind) continue;
+
+		//wind counter-clockwise (occluders are drawn double-sided):
+		float area = Edge(v[0], v[1]).at(v[2].x, v[2].y);
+		if (area == 0.0f) continue;
+		if (area < 0.0f) {
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		//pixel bounds (rows clipped to the screen, columns to whole blocks of four):
+		int32_t x0 = std::max(0, int32_t(std::floor(std::min(std::min(v[0].x, v[1].x), v[2].x))));
+		int32_t x1 = std::min(int32_t(target.width), int32_t(std::ceil(std::max(std::max(v[0].x, v[1].x), v[2].x))));
+		int32_t y0 = std::max(0, int32_t(std::floor(std::min(std::min(v[0].y, v[1].y), v[2].y))));
+		int32_t y1 = std::min(int32_t(target.height), int32_t(std::ceil(std::max(std::max(v[0].y, v[1].y), v[2].y))));
+		if (x0 >= x1 || y0 >= y1) continue;
+		x0 &= ~3;
+
+		//edge opposite each vertex, and the plane 1/w takes over the screen:
+		Edge e0(v[1], v[2]), e1(v[2], v[0]), e2(v[0], v[1]);
+		float inv_area = 1.0f / area;
+		Edge depth = e0;
+		depth.a = (e0.a * v[0].inv_w + e1.a * v[1].inv_w + e2.a * v[2].inv_w) * inv_area;
+		depth.b = (e0.b * v[0].inv_w + e1.b * v[1].inv_w + e2.b * v[2].inv_w) * inv_area;
+		depth.c = (e0.c * v[0].inv_w + e1.c * v[1].inv_w + e2.c * v[2].inv_w) * inv_area;
+
+		//sample at pixel centers; each block steps four pixels right:
+		Lanes offsets = lanes(0.5f, 1.5f, 2.5f, 3.5f);
+		Lanes e0_step = splat(4.0f * e0.a), e1_step = splat(4.0f * e1.a), e2_step = splat(4.0f * e2.a);
+		Lanes depth_step = splat(4.0f * depth.a);
+		for (int32_t y = y0; y < y1; ++y) {
+			float py = float(y) + 0.5f;
+			Lanes px = splat(float(x0)) + offsets;
+			Lanes w0 = splat(e0.a) * px + splat(e0.b * py + e0.c);
+			Lanes w1 = splat(e1.a) * px + splat(e1.b * py + e1.c);
+			Lanes w2 = splat(e2.a) * px + splat(e2.b * py + e2.c);
+			Lanes z = splat(depth.a) * px + splat(depth.b * py + depth.c);
+			float *row = &target.depth[y * target.width];
+			for (int32_t x = x0; x < x1; x += 4) {
+				store_inside(row + x, z, w0, w1, w2);
+				w0 = w0 + e0_step;
+				w1 = w1 + e1_step;
+				w2 = w2 + e2_step;
+				z = z + depth_step;
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::build_pyramid() {
+	for (uint32_t l = 1; l < levels.size(); ++l) {
+		Level const &below = levels[l-1];
+		Level &level = levels[l];
+		for (uint32_t y = 0; y < level.height; ++y) {
+			uint32_t by0 = std::min(2 * y, below.height - 1);
+			uint32_t by1 = std::min(2 * y + 1, below.height - 1);
+			for (uint32_t x = 0; x < level.width; ++x) {
+				uint32_t bx0 = std::min(2 * x, below.width - 1);
+				uint32_t bx1 = std::min(2 * x + 1, below.width - 1);
+				level.depth[y * level.width + x] = std::min(
+					std::min(below.depth[by0 * below.width + bx0], below.depth[by0 * below.width + bx1]),
+					std::min(below.depth[by1 * below.width + bx0], below.depth[by1 * below.width + bx1])
+				);
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::box_occluded(glm::mat4 const &to_clip, glm::vec3 const &min, glm::vec3 const &max) const {
+	Level const &base = levels[0];
+
+	//screen rectangle and nearest 1/w of the box's corners:
+	float x_min = std::numeric_limits< float >::infinity(), x_max = -x_min;
+	float y_min = x_min, y_max = -x_min;
+	float nearest = 0.0f;
+	for (uint32_t c = 0; c < 8; ++c) {
+		glm::vec4 clip = to_clip * glm::vec4(
+			(c & 1 ? max.x : min.x),
+			(c & 2 ? max.y : min.y),
+			(c & 4 ? max.z : min.z),
+			1.0f
+		);
+		if (clip.w < MinW) return false;
+		float inv_w = 1.0f / clip.w;
+		float x = (clip.x * inv_w * 0.5f + 0.5f) * base.width;
+		float y = (clip.y * inv_w * 0.5f + 0.5f) * base.height;
+		x_min = std::min(x_min, x); x_max = std::max(x_max, x);
+		y_min = std::min(y_min, y); y_max = std::max(y_max, y);
+		nearest = std::max(nearest, inv_w);
+	}
+	if (x_min < 0.0f || y_min < 0.0f || x_max > base.width || y_max > base.height) return false;
+	nearest *= 1.0f + OccludedMargin;
+
+	//covered pixels, then climb the pyramid until they fit in (about) a 2x2 block:
+	uint32_t x0 = uint32_t(x_min), x1 = std::min(base.width - 1, uint32_t(x_max));
+	uint32_t y0 = uint32_t(y_min), y1 = std::min(base.height - 1, uint32_t(y_max));
+	uint32_t l = 0;
+	while (l + 1 < levels.size() && (x1 - x0 > 1 || y1 - y0 > 1)) {
+		++l;
+		x0 /= 2; x1 /= 2;
+		y0 /= 2; y1 /= 2;
+	}
+
+	Level const &level = levels[l];
+	for (uint32_t y = y0; y <= y1; ++y) {
+		for (uint32_t x = x0; x <= x1; ++x) {
+			if (level.depth[y * level.width + x] <= nearest) return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+//"OcclusionBuffer" is a small CPU-side depth buffer for occlusion culling:
+// occluder triangles are rasterized into it (four pixels at a time with SSE when available),
+// a hierarchical-Z pyramid is built over it, and bounding boxes are then tested against the pyramid.
+//It doesn't touch OpenGL, so it can run (and be benchmarked -- see bench_occlusion.cpp) headless.
+//Depth is stored as 1/w (clip-space w), which interpolates linearly across the screen;
+// larger values are nearer, and 0 means nothing was drawn.
+struct OcclusionBuffer {
+	//width is rounded up to a multiple of four:
+	OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+	//reset to empty (nothing occludes anything):
+	void clear();
+
+	//rasterize triangles -- three consecutive vertices each -- whose positions (three floats)
+	// start at 'positions' and are 'stride' bytes apart, after transforming by 'object_to_clip':
+	// (triangles that cross the w = 0 plane are skipped rather than clipped, so occlusion is underestimated, never over)
+	void rasterize_triangles(glm::mat4 const &object_to_clip, uint8_t const *positions, uint32_t stride, uint32_t vertex_count);
+
+	//rebuild the pyramid from the current depths (call after rasterizing, before testing):
+	void build_pyramid();
+
+	//is the box [min,max] (transformed by 'to_clip') entirely behind what was rasterized?
+	// (conservative: boxes crossing w = 0 or leaving the screen are never occluded)
+	bool box_occluded(glm::mat4 const &to_clip, glm::vec3 const &min, glm::vec3 const &max) const;
+
+	//pyramid levels: levels[0] is the rasterized depth; each texel of a later level
+	// holds the farthest (smallest) value of the 2x2 texels below it:
+	struct Level {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector< float > depth; //row-major, row 0 at the bottom of the screen
+	};
+	std::vector< Level > levels;
+};
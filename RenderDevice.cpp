@@ -0,0 +1,306 @@
+#include "RenderDevice.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <unordered_map>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+static GLRenderDevice gl_render_device;
+RenderDevice *RenderDevice::current = &gl_render_device;
+
+//------ GLRenderDevice ------
+
+void GLRenderDevice::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	glViewport(x, y, width, height);
+}
+void GLRenderDevice::scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+	glScissor(x, y, width, height);
+}
+void GLRenderDevice::clear_color(glm::vec4 const &color) {
+	glClearColor(color.r, color.g, color.b, color.a);
+}
+void GLRenderDevice::clear(GLbitfield mask) {
+	glClear(mask);
+}
+void GLRenderDevice::enable(GLenum cap) {
+	glEnable(cap);
+}
+void GLRenderDevice::disable(GLenum cap) {
+	glDisable(cap);
+}
+void GLRenderDevice::blend_equation(GLenum mode) {
+	glBlendEquation(mode);
+}
+void GLRenderDevice::blend_func(GLenum src, GLenum dst) {
+	glBlendFunc(src, dst);
+}
+
+void GLRenderDevice::get_viewport(GLint viewport[4]) {
+	glGetIntegerv(GL_VIEWPORT, viewport);
+}
+GLint GLRenderDevice::uniform_buffer_offset_alignment() {
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return alignment;
+}
+
+void GLRenderDevice::use_program(GLuint program) {
+	glUseProgram(program);
+}
+void GLRenderDevice::uniform(GLint location, float value) {
+	glUniform1f(location, value);
+}
+void GLRenderDevice::uniform(GLint location, glm::vec3 const &value) {
+	glUniform3fv(location, 1, glm::value_ptr(value));
+}
+void GLRenderDevice::uniform(GLint location, glm::vec4 const &value) {
+	glUniform4fv(location, 1, glm::value_ptr(value));
+}
+void GLRenderDevice::uniform(GLint location, glm::mat3 const &value) {
+	glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+void GLRenderDevice::uniform(GLint location, glm::mat4x3 const &value) {
+	glUniformMatrix4x3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+void GLRenderDevice::uniform(GLint location, glm::mat4 const &value) {
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+GLuint GLRenderDevice::create_buffer() {
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	return buffer;
+}
+void GLRenderDevice::delete_buffer(GLuint buffer) {
+	glDeleteBuffers(1, &buffer);
+}
+void GLRenderDevice::bind_buffer(GLenum target, GLuint buffer) {
+	glBindBuffer(target, buffer);
+}
+void GLRenderDevice::buffer_data(GLenum target, GLsizeiptr size, void const *data, GLenum usage) {
+	glBufferData(target, size, data, usage);
+}
+void GLRenderDevice::buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, void const *data) {
+	glBufferSubData(target, offset, size, data);
+}
+void GLRenderDevice::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLRenderDevice::bind_vertex_array(GLuint vao) {
+	glBindVertexArray(vao);
+}
+void GLRenderDevice::draw_arrays(GLenum mode, GLint first, GLsizei count) {
+	glDrawArrays(mode, first, count);
+}
+void GLRenderDevice::draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count) {
+	glDrawArraysInstanced(mode, first, count, instance_count);
+}
+
+//------ RecordingRenderDevice ------
+
+//read a uniform value back out of a command's data:
+template< typename T >
+static T read_value(RecordingRenderDevice::Command const &command, std::vector< uint8_t > const &data) {
+	assert(command.data_end - command.data_begin == sizeof(T) && "command holds one value");
+	T value;
+	std::memcpy(static_cast< void * >(&value), &data[command.data_begin], sizeof(T));
+	return value;
+}
+
+RecordingRenderDevice::Command &RecordingRenderDevice::record(Op op, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e) {
+	uint32_t at = uint32_t(data.size());
+	commands.emplace_back(Command{op, {a, b, c, d, e}, at, at});
+	return commands.back();
+}
+
+void RecordingRenderDevice::record_data(Command &command, void const *bytes, size_t size) {
+	assert(command.data_end == data.size() && "data is appended to the latest command");
+	uint8_t const *begin = reinterpret_cast< uint8_t const * >(bytes);
+	data.insert(data.end(), begin, begin + size);
+	command.data_end = uint32_t(data.size());
+}
+
+void RecordingRenderDevice::reset() {
+	commands.clear();
+	data.clear();
+}
+
+uint32_t RecordingRenderDevice::count(Op op) const {
+	uint32_t ret = 0;
+	for (auto const &command : commands) {
+		if (command.op == op) ++ret;
+	}
+	return ret;
+}
+
+uint32_t RecordingRenderDevice::first_difference(RecordingRenderDevice const &other) const {
+	uint32_t common = uint32_t(std::min(commands.size(), other.commands.size()));
+	for (uint32_t i = 0; i < common; ++i) {
+		Command const &a = commands[i];
+		Command const &b = other.commands[i];
+		if (a.op != b.op || std::memcmp(a.args, b.args, sizeof(a.args)) != 0) return i;
+		uint32_t size = a.data_end - a.data_begin;
+		if (size != b.data_end - b.data_begin) return i;
+		if (size != 0 && std::memcmp(&data[a.data_begin], &other.data[b.data_begin], size) != 0) return i;
+	}
+	if (commands.size() != other.commands.size()) return common;
+	return -1U;
+}
+
+void RecordingRenderDevice::replay(RenderDevice &target) const {
+	//names of buffers created during the recording, as created on 'target':
+	std::unordered_map< GLuint, GLuint > buffers;
+	auto buffer = [&buffers](uint32_t name) -> GLuint {
+		auto f = buffers.find(name);
+		return (f == buffers.end() ? name : f->second);
+	};
+
+	for (auto const &command : commands) {
+		uint32_t const *args = command.args;
+		void const *bytes = (command.data_end > command.data_begin ? &data[command.data_begin] : nullptr);
+		switch (command.op) {
+			case Viewport: target.viewport(GLint(args[0]), GLint(args[1]), GLsizei(args[2]), GLsizei(args[3])); break;
+			case Scissor: target.scissor(GLint(args[0]), GLint(args[1]), GLsizei(args[2]), GLsizei(args[3])); break;
+			case ClearColor: target.clear_color(read_value< glm::vec4 >(command, data)); break;
+			case Clear: target.clear(args[0]); break;
+			case Enable: target.enable(args[0]); break;
+			case Disable: target.disable(args[0]); break;
+			case BlendEquation: target.blend_equation(args[0]); break;
+			case BlendFunc: target.blend_func(args[0], args[1]); break;
+			case UseProgram: target.use_program(args[0]); break;
+			case UniformFloat: target.uniform(GLint(args[0]), read_value< float >(command, data)); break;
+			case UniformVec3: target.uniform(GLint(args[0]), read_value< glm::vec3 >(command, data)); break;
+			case UniformVec4: target.uniform(GLint(args[0]), read_value< glm::vec4 >(command, data)); break;
+			case UniformMat3: target.uniform(GLint(args[0]), read_value< glm::mat3 >(command, data)); break;
+			case UniformMat4x3: target.uniform(GLint(args[0]), read_value< glm::mat4x3 >(command, data)); break;
+			case UniformMat4: target.uniform(GLint(args[0]), read_value< glm::mat4 >(command, data)); break;
+			case CreateBuffer: buffers[args[0]] = target.create_buffer(); break;
+			case DeleteBuffer: target.delete_buffer(buffer(args[0])); buffers.erase(args[0]); break;
+			case BindBuffer: target.bind_buffer(args[0], buffer(args[1])); break;
+			case BufferData: target.buffer_data(args[0], GLsizeiptr(args[1]), bytes, args[2]); break;
+			case BufferSubData: if (bytes) target.buffer_sub_data(args[0], GLintptr(args[1]), GLsizeiptr(args[2]), bytes); break; //(contents weren't kept)
+			case BindBufferRange: target.bind_buffer_range(args[0], args[1], buffer(args[2]), GLintptr(args[3]), GLsizeiptr(args[4])); break;
+			case BindVertexArray: target.bind_vertex_array(args[0]); break;
+			case DrawArrays: target.draw_arrays(args[0], GLint(args[1]), GLsizei(args[2])); break;
+			case DrawArraysInstanced: target.draw_arrays_instanced(args[0], GLint(args[1]), GLsizei(args[2]), GLsizei(args[3])); break;
+			case OpCount: assert(0 && "OpCount is not an op"); break;
+		}
+	}
+}
+
+void RecordingRenderDevice::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	record(Viewport, uint32_t(x), uint32_t(y), uint32_t(width), uint32_t(height));
+	if (forward) forward->viewport(x, y, width, height);
+}
+void RecordingRenderDevice::scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+	record(Scissor, uint32_t(x), uint32_t(y), uint32_t(width), uint32_t(height));
+	if (forward) forward->scissor(x, y, width, height);
+}
+void RecordingRenderDevice::clear_color(glm::vec4 const &color) {
+	record_data(record(ClearColor), &color, sizeof(color));
+	if (forward) forward->clear_color(color);
+}
+void RecordingRenderDevice::clear(GLbitfield mask) {
+	record(Clear, mask);
+	if (forward) forward->clear(mask);
+}
+void RecordingRenderDevice::enable(GLenum cap) {
+	record(Enable, cap);
+	if (forward) forward->enable(cap);
+}
+void RecordingRenderDevice::disable(GLenum cap) {
+	record(Disable, cap);
+	if (forward) forward->disable(cap);
+}
+void RecordingRenderDevice::blend_equation(GLenum mode) {
+	record(BlendEquation, mode);
+	if (forward) forward->blend_equation(mode);
+}
+void RecordingRenderDevice::blend_func(GLenum src, GLenum dst) {
+	record(BlendFunc, src, dst);
+	if (forward) forward->blend_func(src, dst);
+}
+
+void RecordingRenderDevice::get_viewport(GLint viewport[4]) {
+	if (forward) {
+		forward->get_viewport(viewport);
+	} else {
+		std::memcpy(viewport, viewport_answer, sizeof(viewport_answer));
+	}
+}
+GLint RecordingRenderDevice::uniform_buffer_offset_alignment() {
+	return (forward ? forward->uniform_buffer_offset_alignment() : alignment_answer);
+}
+
+void RecordingRenderDevice::use_program(GLuint program) {
+	record(UseProgram, program);
+	if (forward) forward->use_program(program);
+}
+void RecordingRenderDevice::uniform(GLint location, float value) {
+	record_data(record(UniformFloat, uint32_t(location)), &value, sizeof(value));
+	if (forward) forward->uniform(location, value);
+}
+void RecordingRenderDevice::uniform(GLint location, glm::vec3 const &value) {
+	record_data(record(UniformVec3, uint32_t(location)), &value, sizeof(value));
+	if (forward) forward->uniform(location, value);
+}
+void RecordingRenderDevice::uniform(GLint location, glm::vec4 const &value) {
+	record_data(record(UniformVec4, uint32_t(location)), &value, sizeof(value));
+	if (forward) forward->uniform(location, value);
+}
+void RecordingRenderDevice::uniform(GLint location, glm::mat3 const &value) {
+	record_data(record(UniformMat3, uint32_t(location)), &value, sizeof(value));
+	if (forward) forward->uniform(location, value);
+}
+void RecordingRenderDevice::uniform(GLint location, glm::mat4x3 const &value) {
+	record_data(record(UniformMat4x3, uint32_t(location)), &value, sizeof(value));
+	if (forward) forward->uniform(location, value);
+}
+void RecordingRenderDevice::uniform(GLint location, glm::mat4 const &value) {
+	record_data(record(UniformMat4, uint32_t(location)), &value, sizeof(value));
+	if (forward) forward->uniform(location, value);
+}
+
+GLuint RecordingRenderDevice::create_buffer() {
+	GLuint buffer = (forward ? forward->create_buffer() : next_buffer++);
+	record(CreateBuffer, buffer);
+	return buffer;
+}
+void RecordingRenderDevice::delete_buffer(GLuint buffer) {
+	record(DeleteBuffer, buffer);
+	if (forward) forward->delete_buffer(buffer);
+}
+void RecordingRenderDevice::bind_buffer(GLenum target, GLuint buffer) {
+	record(BindBuffer, target, buffer);
+	if (forward) forward->bind_buffer(target, buffer);
+}
+void RecordingRenderDevice::buffer_data(GLenum target, GLsizeiptr size, void const *bytes, GLenum usage) {
+	Command &command = record(BufferData, target, uint32_t(size), usage);
+	if (record_buffer_data && bytes) record_data(command, bytes, size_t(size));
+	if (forward) forward->buffer_data(target, size, bytes, usage);
+}
+void RecordingRenderDevice::buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, void const *bytes) {
+	Command &command = record(BufferSubData, target, uint32_t(offset), uint32_t(size));
+	if (record_buffer_data && bytes) record_data(command, bytes, size_t(size));
+	if (forward) forward->buffer_sub_data(target, offset, size, bytes);
+}
+void RecordingRenderDevice::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	record(BindBufferRange, target, index, buffer, uint32_t(offset), uint32_t(size));
+	if (forward) forward->bind_buffer_range(target, index, buffer, offset, size);
+}
+
+void RecordingRenderDevice::bind_vertex_array(GLuint vao) {
+	record(BindVertexArray, vao);
+	if (forward) forward->bind_vertex_array(vao);
+}
+void RecordingRenderDevice::draw_arrays(GLenum mode, GLint first, GLsizei count) {
+	record(DrawArrays, mode, uint32_t(first), uint32_t(count));
+	if (forward) forward->draw_arrays(mode, first, count);
+}
+void RecordingRenderDevice::draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count) {
+	record(DrawArraysInstanced, mode, uint32_t(first), uint32_t(count), uint32_t(instance_count));
+	if (forward) forward->draw_arrays_instanced(mode, first, count, instance_count);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+//"RenderDevice" is the thin layer that per-frame drawing (Scene::submit, draw_text, and the modes' draw functions) goes through,
+// so that draw traffic can be swapped to another backend -- e.g. recorded, counted, and replayed without a GL context.
+//Load-time resource setup (compile_program, MeshBuffer, bake_static) still calls GL directly.
+//Calls mirror the GL functions they are named after.
+struct RenderDevice {
+	virtual ~RenderDevice() { }
+
+	//fixed-function state:
+	virtual void viewport(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+	virtual void scissor(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+	virtual void clear_color(glm::vec4 const &color) = 0;
+	virtual void clear(GLbitfield mask) = 0;
+	virtual void enable(GLenum cap) = 0;
+	virtual void disable(GLenum cap) = 0;
+	virtual void blend_equation(GLenum mode) = 0;
+	virtual void blend_func(GLenum src, GLenum dst) = 0;
+
+	//queries (not commands -- recording backends answer these themselves):
+	virtual void get_viewport(GLint viewport[4]) = 0;
+	virtual GLint uniform_buffer_offset_alignment() = 0;
+
+	//programs and (single-value) uniforms:
+	virtual void use_program(GLuint program) = 0;
+	virtual void uniform(GLint location, float value) = 0;
+	virtual void uniform(GLint location, glm::vec3 const &value) = 0;
+	virtual void uniform(GLint location, glm::vec4 const &value) = 0;
+	virtual void uniform(GLint location, glm::mat3 const &value) = 0;
+	virtual void uniform(GLint location, glm::mat4x3 const &value) = 0;
+	virtual void uniform(GLint location, glm::mat4 const &value) = 0;
+
+	//buffers:
+	virtual GLuint create_buffer() = 0;
+	virtual void delete_buffer(GLuint buffer) = 0;
+	virtual void bind_buffer(GLenum target, GLuint buffer) = 0;
+	virtual void buffer_data(GLenum target, GLsizeiptr size, void const *data, GLenum usage) = 0;
+	virtual void buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, void const *data) = 0;
+	virtual void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) = 0;
+
+	//vertex arrays and drawing:
+	virtual void bind_vertex_array(GLuint vao) = 0;
+	virtual void draw_arrays(GLenum mode, GLint first, GLsizei count) = 0;
+	virtual void draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count) = 0;
+
+	//RenderDevice::current is the device drawing code uses (a GLRenderDevice unless changed):
+	static RenderDevice *current;
+};
+
+//issues real GL calls:
+struct GLRenderDevice : RenderDevice {
+	virtual void viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+	virtual void scissor(GLint x, GLint y, GLsizei width, GLsizei height) override;
+	virtual void clear_color(glm::vec4 const &color) override;
+	virtual void clear(GLbitfield mask) override;
+	virtual void enable(GLenum cap) override;
+	virtual void disable(GLenum cap) override;
+	virtual void blend_equation(GLenum mode) override;
+	virtual void blend_func(GLenum src, GLenum dst) override;
+	virtual void get_viewport(GLint viewport[4]) override;
+	virtual GLint uniform_buffer_offset_alignment() override;
+	virtual void use_program(GLuint program) override;
+	virtual void uniform(GLint location, float value) override;
+	virtual void uniform(GLint location, glm::vec3 const &value) override;
+	virtual void uniform(GLint location, glm::vec4 const &value) override;
+	virtual void uniform(GLint location, glm::mat3 const &value) override;
+	virtual void uniform(GLint location, glm::mat4x3 const &value) override;
+	virtual void uniform(GLint location, glm::mat4 const &value) override;
+	virtual GLuint create_buffer() override;
+	virtual void delete_buffer(GLuint buffer) override;
+	virtual void bind_buffer(GLenum target, GLuint buffer) override;
+	virtual void buffer_data(GLenum target, GLsizeiptr size, void const *data, GLenum usage) override;
+	virtual void buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, void const *data) override;
+	virtual void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) override;
+	virtual void bind_vertex_array(GLuint vao) override;
+	virtual void draw_arrays(GLenum mode, GLint first, GLsizei count) override;
+	virtual void draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count) override;
+};
+
+//captures calls as a compact command stream that can be counted, compared, and replayed onto another device:
+// (if 'forward' is set, calls are also passed on to it, so a frame can be captured while it is drawn)
+struct RecordingRenderDevice : RenderDevice {
+	enum Op : uint32_t {
+		Viewport, Scissor, ClearColor, Clear, Enable, Disable, BlendEquation, BlendFunc,
+		UseProgram, UniformFloat, UniformVec3, UniformVec4, UniformMat3, UniformMat4x3, UniformMat4,
+		CreateBuffer, DeleteBuffer, BindBuffer, BufferData, BufferSubData, BindBufferRange,
+		BindVertexArray, DrawArrays, DrawArraysInstanced,
+		OpCount
+	};
+	struct Command {
+		Op op;
+		uint32_t args[5]; //call arguments, in order (sizes and offsets truncated to 32 bits)
+		uint32_t data_begin, data_end; //range in 'data' holding uniform values or buffer contents
+	};
+	std::vector< Command > commands;
+	std::vector< uint8_t > data;
+
+	RenderDevice *forward = nullptr;
+
+	//buffer_data and buffer_sub_data copy their contents into 'data' (otherwise only sizes are kept, and replay uploads nothing):
+	bool record_buffer_data = true;
+
+	//answers to queries when not forwarding:
+	GLint viewport_answer[4] = {0, 0, 640, 400};
+	GLint alignment_answer = 256;
+
+	//start a new recording:
+	void reset();
+
+	//number of recorded commands with a given op:
+	uint32_t count(Op op) const;
+	uint32_t draw_calls() const { return count(DrawArrays) + count(DrawArraysInstanced); }
+
+	//index of the first command that differs from 'other' (including its data), or -1U if the streams match:
+	uint32_t first_difference(RecordingRenderDevice const &other) const;
+
+	//issue the recorded commands on 'target' (buffers created during the recording are created anew on 'target'):
+	void replay(RenderDevice &target) const;
+
+	virtual void viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+	virtual void scissor(GLint x, GLint y, GLsizei width, GLsizei height) override;
+	virtual void clear_color(glm::vec4 const &color) override;
+	virtual void clear(GLbitfield mask) override;
+	virtual void enable(GLenum cap) override;
+	virtual void disable(GLenum cap) override;
+	virtual void blend_equation(GLenum mode) override;
+	virtual void blend_func(GLenum src, GLenum dst) override;
+	virtual void get_viewport(GLint viewport[4]) override;
+	virtual GLint uniform_buffer_offset_alignment() override;
+	virtual void use_program(GLuint program) override;
+	virtual void uniform(GLint location, float value) override;
+	virtual void uniform(GLint location, glm::vec3 const &value) override;
+	virtual void uniform(GLint location, glm::vec4 const &value) override;
+	virtual void uniform(GLint location, glm::mat3 const &value) override;
+	virtual void uniform(GLint location, glm::mat4x3 const &value) override;
+	virtual void uniform(GLint location, glm::mat4 const &value) override;
+	virtual GLuint create_buffer() override;
+	virtual void delete_buffer(GLuint buffer) override;
+	virtual void bind_buffer(GLenum target, GLuint buffer) override;
+	virtual void buffer_data(GLenum target, GLsizeiptr size, void const *data, GLenum usage) override;
+	virtual void buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, void const *data) override;
+	virtual void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) override;
+	virtual void bind_vertex_array(GLuint vao) override;
+	virtual void draw_arrays(GLenum mode, GLint first, GLsizei count) override;
+	virtual void draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count) override;
+
+private:
+	Command &record(Op op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0, uint32_t e = 0);
+	void record_data(Command &command, void const *bytes, size_t size);
+	GLuint next_buffer = 1; //names handed out when not forwarding
+};
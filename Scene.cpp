@@ -1,60 +1,84 @@
 #include "Scene.hpp"
+#include "parallel_for.hpp"
+#include "transform_kernels.hpp"
+#include "MappedFile.hpp"
+#include "RenderDevice.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+//helpers that build transform matrices from position/rotation/scale (shared by Transform and 'flat' storage):
+// (these go through the batched kernels, so on-demand and flat results agree exactly)
+static glm::mat4 make_local_to_parent(glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
+	glm::mat4 ret;
+	make_local_to_parent(1, &position, &rotation, &scale, &ret);
+	return ret;
+}
+
+static glm::mat4 make_parent_to_local(glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
+	glm::mat4 ret;
+	make_parent_to_local(1, &position, &rotation, &scale, &ret);
+	return ret;
+}
 
 glm::mat4 Scene::Transform::make_local_to_parent() const {
-	return glm::mat4( //translate
-		glm::vec4(1.0f, 0.0f, 0.0f, 0.0f),
-		glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),
-		glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
-		glm::vec4(position, 1.0f)
-	)
-	* glm::mat4_cast(rotation) //rotate
-	* glm::mat4( //scale
-		glm::vec4(scale.x, 0.0f, 0.0f, 0.0f),
-		glm::vec4(0.0f, scale.y, 0.0f, 0.0f),
-		glm::vec4(0.0f, 0.0f, scale.z, 0.0f),
-		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
-	);
+	return ::make_local_to_parent(position, rotation, scale);
 }
 
 glm::mat4 Scene::Transform::make_parent_to_local() const {
-	glm::vec3 inv_scale;
-	inv_scale.x = (scale.x == 0.0f ? 0.0f : 1.0f / scale.x);
-	inv_scale.y = (scale.y == 0.0f ? 0.0f : 1.0f / scale.y);
-	inv_scale.z = (scale.z == 0.0f ? 0.0f : 1.0f / scale.z);
-	return glm::mat4( //un-scale
-		glm::vec4(inv_scale.x, 0.0f, 0.0f, 0.0f),
-		glm::vec4(0.0f, inv_scale.y, 0.0f, 0.0f),
-		glm::vec4(0.0f, 0.0f, inv_scale.z, 0.0f),
-		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
-	)
-	* glm::mat4_cast(glm::inverse(rotation)) //un-rotate
-	* glm::mat4( //un-translate
-		glm::vec4(1.0f, 0.0f, 0.0f, 0.0f),
-		glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),
-		glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
-		glm::vec4(-position, 1.0f)
-	);
+	return ::make_parent_to_local(position, rotation, scale);
 }
 
 glm::mat4 Scene::Transform::make_local_to_world() const {
-	if (parent) {
-		return parent->make_local_to_world() * make_local_to_parent();
-	} else {
-		return make_local_to_parent();
-	}
+	update_cache();
+	return cache.local_to_world;
 }
 
 glm::mat4 Scene::Transform::make_world_to_local() const {
+	update_cache();
+	return cache.world_to_local;
+}
+
+void Scene::Transform::update_cache() const {
+	uint32_t parent_stamp = 0;
+	if (parent) {
+		parent->update_cache();
+		parent_stamp = parent->cache.stamp;
+	}
+
+	//nothing changed since the last rebuild:
+	if (!cache.dirty
+	 && cache.parent_stamp == parent_stamp
+	 && cache.position == position
+	 && cache.rotation == rotation
+	 && cache.scale == scale) {
+		return;
+	}
+
 	if (parent) {
-		return make_parent_to_local() * parent->make_world_to_local();
+		cache.local_to_world = multiply_affine(parent->cache.local_to_world, make_local_to_parent());
+		cache.world_to_local = multiply_affine(make_parent_to_local(), parent->cache.world_to_local);
 	} else {
-		return make_parent_to_local();
+		cache.local_to_world = make_local_to_parent();
+		cache.world_to_local = make_parent_to_local();
 	}
+
+	cache.position = position;
+	cache.rotation = rotation;
+	cache.scale = scale;
+	cache.parent_stamp = parent_stamp;
+	cache.dirty = false;
+	cache.stamp += 1; //lets children know they need to rebuild
 }
 
 void Scene::Transform::DEBUG_assert_valid_pointers() const {
@@ -96,6 +120,8 @@ void Scene::Transform::set_parent(Transform *new_parent, Transform *before) {
 		}
 		if (prev_sibling) prev_sibling->next_sibling = this;
 	}
+	//world matrices of this transform (and, through 'stamp', its descendants) are now stale:
+	cache.dirty = true;
 	DEBUG_assert_valid_pointers();
 }
 
@@ -107,10 +133,10 @@ glm::mat4 Scene::Camera::make_projection() const {
 
 //---------------------------
 
-//templated helper functions to avoid having to write the same new/delete code three times:
+//templated helper functions to avoid having to write the same new/delete code for every kind of scene thing:
 template< typename T, typename... Args >
-T *list_new(T * &first, Args&&... args) {
-	T *t = new T(std::forward< Args >(args)...); //"perfect forwarding"
+T *list_new(Scene::Pool< T > &pool, T * &first, Args&&... args) {
+	T *t = pool.create(std::forward< Args >(args)...); //"perfect forwarding"
 	if (first) {
 		t->alloc_next = first;
 		first->alloc_prev_next = &t->alloc_next;
@@ -121,7 +147,7 @@ T *list_new(T * &first, Args&&... args) {
 }
 
 template< typename T >
-void list_delete(T * t) {
+void list_delete(Scene::Pool< T > &pool, T * t) {
 	assert(t && "It is invalid to delete a null scene object [yes this is different than 'delete']");
 	assert(t->alloc_prev_next);
 	if (t->alloc_next) {
@@ -131,82 +157,1640 @@ void list_delete(T * t) {
 	//PARANOIA:
 	t->alloc_next = nullptr;
 	t->alloc_prev_next = nullptr;
+	pool.destroy(t);
 }
 
 Scene::Transform *Scene::new_transform() {
-	return list_new< Scene::Transform >(first_transform);
+	flat.sorted = false;
+	return list_new< Scene::Transform >(transform_pool, first_transform);
 }
 
 void Scene::delete_transform(Scene::Transform *transform) {
-	list_delete< Scene::Transform >(transform);
+	flat.sorted = false;
+	if (transform->name) set_name(transform, 0);
+	list_delete< Scene::Transform >(transform_pool, transform);
 }
 
 Scene::Object *Scene::new_object(Scene::Transform *transform) {
 	assert(transform && "Scene::Object must be attached to a transform.");
-	return list_new< Scene::Object >(first_object, transform);
+	spatial.built = false;
+	return list_new< Scene::Object >(object_pool, first_object, transform);
 }
 
 void Scene::delete_object(Scene::Object *object) {
-	list_delete< Scene::Object >(object);
+	spatial.built = false;
+	if (object->name) set_name(object, 0);
+	list_delete< Scene::Object >(object_pool, object);
 }
 
 Scene::Camera *Scene::new_camera(Scene::Transform *transform) {
 	assert(transform && "Scene::Camera must be attached to a transform.");
-	return list_new< Scene::Camera >(first_camera, transform);
+	return list_new< Scene::Camera >(camera_pool, first_camera, transform);
 }
 
 void Scene::delete_camera(Scene::Camera *object) {
-	list_delete< Scene::Camera >(object);
+	list_delete< Scene::Camera >(camera_pool, object);
+}
+
+Scene::Lamp *Scene::new_lamp(Scene::Transform *transform) {
+	assert(transform && "Scene::Lamp must be attached to a transform.");
+	return list_new< Scene::Lamp >(lamp_pool, first_lamp, transform);
+}
+
+void Scene::delete_lamp(Scene::Lamp *object) {
+	list_delete< Scene::Lamp >(lamp_pool, object);
 }
 
+//---------------------------
+//names:
+
+NameID Scene::intern(char const *begin, char const *end) {
+	NameID id = name_id(begin, end);
+	auto f = names.find(id);
+	if (f == names.end()) {
+		if (id == 0) {
+			throw std::runtime_error("Name '" + std::string(begin, end) + "' has id 0, which means 'no name'; please rename it.");
+		}
+		names[id].name.assign(begin, end);
+	} else if (f->second.name.size() != size_t(end - begin) || !std::equal(begin, end, f->second.name.begin())) {
+		throw std::runtime_error("Names '" + f->second.name + "' and '" + std::string(begin, end) + "' have the same id; please rename one.");
+	}
+	return id;
+}
+
+std::string const &Scene::name_string(NameID id) const {
+	static std::string const none;
+	auto f = names.find(id);
+	return (f == names.end() ? none : f->second.name);
+}
+
+namespace {
+	//remove 'thing' from a name's list (keeping the others in order):
+	template< typename T >
+	void remove_named(std::vector< T * > &list, T *thing) {
+		auto f = std::find(list.begin(), list.end(), thing);
+		assert(f != list.end() && "named things are listed under their name");
+		list.erase(f);
+	}
+}
+
+void Scene::set_name(Scene::Transform *transform, NameID id) {
+	assert(transform);
+	if (transform->name == id) return;
+	if (transform->name) remove_named(names[transform->name].transforms, transform);
+	if (id) {
+		assert(names.count(id) && "name must be interned before use");
+		names[id].transforms.emplace_back(transform);
+	}
+	transform->name = id;
+}
+
+void Scene::set_name(Scene::Object *object, NameID id) {
+	assert(object);
+	if (object->name == id) return;
+	if (object->name) remove_named(names[object->name].objects, object);
+	if (id) {
+		assert(names.count(id) && "name must be interned before use");
+		names[id].objects.emplace_back(object);
+	}
+	object->name = id;
+}
+
+std::vector< Scene::Transform * > const &Scene::find_transforms(NameID id) const {
+	static std::vector< Transform * > const none;
+	auto f = names.find(id);
+	return (f == names.end() ? none : f->second.transforms);
+}
+
+std::vector< Scene::Object * > const &Scene::find_objects(NameID id) const {
+	static std::vector< Object * > const none;
+	auto f = names.find(id);
+	return (f == names.end() ? none : f->second.objects);
+}
+
+Scene::Transform *Scene::find_transform(NameID id) const {
+	std::vector< Transform * > const &found = find_transforms(id);
+	return (found.empty() ? nullptr : found[0]);
+}
+
+Scene::Object *Scene::find_object(NameID id) const {
+	std::vector< Object * > const &found = find_objects(id);
+	return (found.empty() ? nullptr : found[0]);
+}
+
+//---------------------------
+//loading:
+
+namespace {
+	//records in a '.scene' file (see export-scene.py):
+	struct TransformRecord {
+		int32_t parent; //(-1 for none)
+		uint32_t name_begin, name_end;
+		float position[3];
+		float rotation[4]; //x,y,z,w
+		float scale[3];
+	};
+	static_assert(sizeof(TransformRecord) == 52, "transform record is packed");
+
+	struct MeshRecord {
+		int32_t transform;
+		uint32_t name_begin, name_end;
+	};
+	static_assert(sizeof(MeshRecord) == 12, "mesh record is packed");
+
+	struct CameraRecord {
+		int32_t transform;
+		char type[4]; //"pers" or "orth"
+		float size; //vertical fov (degrees) or ortho height
+		float clip_start, clip_end;
+	};
+	static_assert(sizeof(CameraRecord) == 20, "camera record is packed");
+
+	struct LampRecord {
+		int32_t transform;
+		char type; //see Scene::Lamp::Type
+		uint8_t color[3];
+		float energy;
+		float distance;
+		float spot_fov; //(degrees)
+	};
+	static_assert(sizeof(LampRecord) == 20, "lamp record is packed");
+
+	//chunk contents, in place in the mapped file:
+	struct Chunk {
+		uint8_t const *data = nullptr;
+		uint32_t size = 0;
+		bool found = false;
+
+		template< typename T >
+		uint32_t count(std::string const &magic) const {
+			if (size % sizeof(T) != 0) {
+				throw std::runtime_error("Size of chunk '" + magic + "' not divisible by element size");
+			}
+			return size / sizeof(T);
+		}
+		//(records may be unaligned in the file, so they are copied out one at a time)
+		template< typename T >
+		T get(uint32_t i) const {
+			T ret;
+			std::memcpy(&ret, data + i * sizeof(T), sizeof(T));
+			return ret;
+		}
+	};
+}
+
+Scene::Handles Scene::load(std::string const &filename, std::function< Scene::Object *(Scene::Transform *, NameID mesh) > const &make_object) {
+	MappedFile file(filename);
+
+	//find chunks (in any order):
+	char const *magics[5] = {"str0", "xfh0", "msh0", "cam0", "lmp0"};
+	Chunk chunks[5];
+	for (size_t at = 0; at < file.size; ) {
+		if (file.size - at < 8) {
+			throw std::runtime_error("Failed to read chunk header in '" + filename + "'");
+		}
+		char magic[4];
+		uint32_t size;
+		std::memcpy(magic, file.data + at, 4);
+		std::memcpy(&size, file.data + at + 4, 4);
+		at += 8;
+		if (file.size - at < size) {
+			throw std::runtime_error("Chunk '" + std::string(magic, 4) + "' runs past the end of '" + filename + "'");
+		}
+		for (uint32_t c = 0; c < 5; ++c) {
+			if (std::string(magic, 4) == magics[c]) {
+				chunks[c].data = file.data + at;
+				chunks[c].size = size;
+				chunks[c].found = true;
+			}
+		}
+		at += size;
+	}
+	Chunk const &strings = chunks[0];
+	Chunk const &xfh = chunks[1];
+	if (!strings.found || !xfh.found) {
+		throw std::runtime_error("Scene file '" + filename + "' is missing its 'str0' or 'xfh0' chunk");
+	}
+	//names are interned straight from the mapped file (so repeated names cost no allocation):
+	auto get_name = [&](uint32_t begin, uint32_t end) {
+		if (!(begin <= end && end <= strings.size)) {
+			throw std::runtime_error("scene entry has out-of-range name begin/end");
+		}
+		char const *chars = reinterpret_cast< char const * >(strings.data);
+		return intern(chars + begin, chars + end);
+	};
+
+	Handles handles;
+
+	//transforms: parents are written before their children, so one pass in file order builds the hierarchy:
+	uint32_t transform_count = xfh.count< TransformRecord >("xfh0");
+	handles.transforms.reserve(transform_count);
+	handles.names.reserve(transform_count);
+	for (uint32_t i = 0; i < transform_count; ++i) {
+		TransformRecord record = xfh.get< TransformRecord >(i);
+		if (!(record.parent >= -1 && record.parent < int32_t(i))) {
+			throw std::runtime_error("transform scene entry has a parent that is not before it");
+		}
+		Transform *transform = new_transform();
+		transform->position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+		transform->rotation = glm::quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]);
+		transform->scale = glm::vec3(record.scale[0], record.scale[1], record.scale[2]);
+		if (record.parent >= 0) transform->set_parent(handles.transforms[record.parent]);
+		handles.transforms.emplace_back(transform);
+		NameID name = get_name(record.name_begin, record.name_end);
+		set_name(transform, name);
+		handles.names.emplace_back(name, i);
+	}
+	std::sort(handles.names.begin(), handles.names.end());
+	handles.objects.assign(transform_count, nullptr);
+	handles.cameras.assign(transform_count, nullptr);
+	handles.lamps.assign(transform_count, nullptr);
+
+	auto get_transform = [&](int32_t ref) {
+		if (!(ref >= 0 && ref < int32_t(transform_count))) {
+			throw std::runtime_error("scene entry has out of range transform ref");
+		}
+		return uint32_t(ref);
+	};
+
+	if (chunks[2].found) {
+		Chunk const &msh = chunks[2];
+		for (uint32_t i = 0, n = msh.count< MeshRecord >("msh0"); i < n; ++i) {
+			MeshRecord record = msh.get< MeshRecord >(i);
+			uint32_t t = get_transform(record.transform);
+			NameID mesh = get_name(record.name_begin, record.name_end);
+			Object *object = make_object(handles.transforms[t], mesh);
+			if (object && !object->name) set_name(object, mesh);
+			handles.objects[t] = object;
+		}
+	}
+
+	if (chunks[3].found) {
+		Chunk const &cam = chunks[3];
+		for (uint32_t i = 0, n = cam.count< CameraRecord >("cam0"); i < n; ++i) {
+			CameraRecord record = cam.get< CameraRecord >(i);
+			uint32_t t = get_transform(record.transform);
+			Camera *camera = new_camera(handles.transforms[t]);
+			if (std::string(record.type, 4) == "pers") {
+				camera->fovy = glm::radians(record.size);
+			} else {
+				std::cerr << "WARNING: camera in '" << filename << "' is not perspective; loading it with the default fov." << std::endl;
+			}
+			camera->near = record.clip_start;
+			handles.cameras[t] = camera;
+		}
+	}
+
+	if (chunks[4].found) {
+		Chunk const &lmp = chunks[4];
+		for (uint32_t i = 0, n = lmp.count< LampRecord >("lmp0"); i < n; ++i) {
+			LampRecord record = lmp.get< LampRecord >(i);
+			uint32_t t = get_transform(record.transform);
+			if (!(record.type == Lamp::Point || record.type == Lamp::Hemisphere || record.type == Lamp::Spot || record.type == Lamp::Directional)) {
+				throw std::runtime_error("lamp scene entry has unknown type '" + std::string(1, record.type) + "'");
+			}
+			Lamp *lamp = new_lamp(handles.transforms[t]);
+			lamp->type = Lamp::Type(record.type);
+			lamp->color = glm::vec3(record.color[0], record.color[1], record.color[2]) / 255.0f;
+			lamp->energy = record.energy;
+			lamp->distance = record.distance;
+			lamp->spot_fov = glm::radians(record.spot_fov);
+			handles.lamps[t] = lamp;
+		}
+	}
+
+	return handles;
+}
+
+uint32_t Scene::Handles::find(NameID name) const {
+	auto f = std::lower_bound(names.begin(), names.end(), name, [](std::pair< NameID, uint32_t > const &a, NameID b) {
+		return a.first < b;
+	});
+	if (f == names.end() || f->first != name) return -1U;
+	return f->second;
+}
+
+Scene::Transform *Scene::Handles::transform(NameID name) const {
+	uint32_t i = find(name);
+	return (i == -1U ? nullptr : transforms[i]);
+}
+
+Scene::Object *Scene::Handles::object(NameID name) const {
+	uint32_t i = find(name);
+	return (i == -1U ? nullptr : objects[i]);
+}
+
+Scene::Camera *Scene::Handles::camera(NameID name) const {
+	uint32_t i = find(name);
+	return (i == -1U ? nullptr : cameras[i]);
+}
+
+Scene::Lamp *Scene::Handles::lamp(NameID name) const {
+	uint32_t i = find(name);
+	return (i == -1U ? nullptr : lamps[i]);
+}
+
+//---------------------------
+//culling helpers:
+
+namespace {
+	//planes (pointing inward) of a view frustum, extracted from a world-to-clip matrix:
+	struct Frustum {
+		//left, right, bottom, top, near -- Camera::make_projection() has no far plane:
+		glm::vec4 planes[5];
+		Frustum(glm::mat4 const &world_to_clip) {
+			glm::vec4 row[4];
+			for (uint32_t r = 0; r < 4; ++r) {
+				row[r] = glm::vec4(world_to_clip[0][r], world_to_clip[1][r], world_to_clip[2][r], world_to_clip[3][r]);
+			}
+			planes[0] = row[3] + row[0];
+			planes[1] = row[3] - row[0];
+			planes[2] = row[3] + row[1];
+			planes[3] = row[3] - row[1];
+			planes[4] = row[3] + row[2];
+			for (auto &plane : planes) {
+				plane /= glm::length(glm::vec3(plane));
+			}
+		}
+	};
+
+	enum Visibility : uint8_t {
+		Outside = 0,
+		Intersecting = 1,
+		Inside = 2,
+	};
+
+	Visibility classify_sphere(Frustum const &frustum, glm::vec3 const &center, float radius) {
+		if (radius < 0.0f) return Outside; //empty
+		Visibility ret = Inside;
+		for (auto const &plane : frustum.planes) {
+			float dist = glm::dot(glm::vec3(plane), center) + plane.w;
+			if (dist < -radius) return Outside;
+			if (dist < radius) ret = Intersecting;
+		}
+		return ret;
+	}
+
+	//box given by center and half-extent, in world space:
+	bool box_outside(Frustum const &frustum, glm::vec3 const &center, glm::vec3 const &extent) {
+		for (auto const &plane : frustum.planes) {
+			float dist = glm::dot(glm::vec3(plane), center) + plane.w;
+			float r = glm::dot(glm::abs(glm::vec3(plane)), extent);
+			if (dist < -r) return true;
+		}
+		return false;
+	}
+
+	//world-space bounding sphere of an object:
+	void object_sphere(Scene::Drawable const &object, glm::mat4 const &local_to_world, glm::vec3 *center, float *radius) {
+		if (object.bounds_radius < 0.0f) {
+			*center = glm::vec3(local_to_world[3]);
+			*radius = std::numeric_limits< float >::infinity();
+			return;
+		}
+		*center = glm::vec3(local_to_world * glm::vec4(object.bounds_center, 1.0f));
+		float scale2 = std::max(
+			glm::dot(local_to_world[0], local_to_world[0]),
+			std::max(glm::dot(local_to_world[1], local_to_world[1]), glm::dot(local_to_world[2], local_to_world[2]))
+		);
+		*radius = object.bounds_radius * std::sqrt(scale2);
+	}
+
+	//world-space axis-aligned box (center and half-extent) around an object's bounds:
+	void object_box(Scene::Drawable const &object, glm::mat4 const &local_to_world, glm::vec3 *center, glm::vec3 *extent) {
+		*center = glm::vec3(local_to_world * glm::vec4(0.5f * (object.bounds_min + object.bounds_max), 1.0f));
+		glm::mat3 abs_rs = glm::mat3(
+			glm::abs(glm::vec3(local_to_world[0])),
+			glm::abs(glm::vec3(local_to_world[1])),
+			glm::abs(glm::vec3(local_to_world[2]))
+		);
+		*extent = abs_rs * (0.5f * (object.bounds_max - object.bounds_min));
+	}
+
+	//full test of an object's bounds (sphere first, then box):
+	bool object_outside(Frustum const &frustum, Scene::Drawable const &object, glm::mat4 const &local_to_world) {
+		if (object.bounds_radius < 0.0f) return false;
+		glm::vec3 center;
+		float radius;
+		object_sphere(object, local_to_world, &center, &radius);
+		Visibility vis = classify_sphere(frustum, center, radius);
+		if (vis != Intersecting) return vis == Outside;
+
+		glm::vec3 box_center, box_extent;
+		object_box(object, local_to_world, &box_center, &box_extent);
+		return box_outside(frustum, box_center, box_extent);
+	}
+
+	//level of detail for an object of projected 'size': 0 at 'full_size' or larger, one more per halving:
+	uint32_t lod_level(float size, float full_size, size_t levels) {
+		uint32_t level = 0;
+		while (level + 1 < levels && size < full_size) {
+			size *= 2.0f;
+			++level;
+		}
+		return level;
+	}
+
+	//grow sphere (center, radius) to include sphere (c2, r2):
+	void merge_sphere(glm::vec3 &center, float &radius, glm::vec3 const &c2, float r2) {
+		if (r2 < 0.0f) return;
+		if (radius < 0.0f) {
+			center = c2;
+			radius = r2;
+			return;
+		}
+		if (std::isinf(radius) || std::isinf(r2)) {
+			radius = std::numeric_limits< float >::infinity();
+			return;
+		}
+		float d = glm::length(c2 - center);
+		if (d + r2 <= radius) return;
+		if (d + radius <= r2) {
+			center = c2;
+			radius = r2;
+			return;
+		}
+		float r = 0.5f * (d + radius + r2);
+		center += (c2 - center) * ((r - radius) / d);
+		radius = r;
+	}
+}
+
+//---------------------------
+
+GLuint Scene::instance_buffer() {
+	static GLuint buffer = 0;
+	if (buffer == 0) {
+		glGenBuffers(1, &buffer);
+	}
+	return buffer;
+}
+
+std::vector< MeshBuffer::InstanceAttrib > const &Scene::instance_attribs() {
+	typedef MeshBuffer::InstanceAttrib InstanceAttrib;
+	typedef MeshBuffer::Attrib Attrib;
+	static std::vector< InstanceAttrib > attribs{
+		InstanceAttrib("ObjectToClip", Attrib(4, GL_FLOAT, GL_FALSE, sizeof(Instance), offsetof(Instance, object_to_clip)), 4),
+		InstanceAttrib("ObjectToLight", Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Instance), offsetof(Instance, object_to_light)), 4),
+		InstanceAttrib("NormalToLight", Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Instance), offsetof(Instance, normal_to_light)), 3),
+	};
+	return attribs;
+}
+
+//---------------------------
+
+void Scene::update_transforms() {
+	//check that the sorted order still matches the hierarchy:
+	if (flat.sorted) {
+		for (uint32_t i = 0; i < flat.transforms.size(); ++i) {
+			uint32_t p = flat.parents[i];
+			if (flat.transforms[i]->parent != (p == -1U ? nullptr : flat.transforms[p])) {
+				flat.sorted = false;
+				break;
+			}
+		}
+	}
+
+	if (!flat.sorted) {
+		//number transforms in allocation order:
+		std::vector< Transform * > unsorted;
+		for (Transform *t = first_transform; t != nullptr; t = t->alloc_next) {
+			t->flat_index = uint32_t(unsorted.size());
+			unsorted.emplace_back(t);
+		}
+
+		//build child lists from parent pointers:
+		std::vector< uint32_t > first_child(unsorted.size(), -1U);
+		std::vector< uint32_t > next_sibling(unsorted.size(), -1U);
+		for (uint32_t i = uint32_t(unsorted.size()); i > 0; --i) {
+			Transform const *parent = unsorted[i-1]->parent;
+			if (parent) {
+				assert(parent->flat_index < unsorted.size() && unsorted[parent->flat_index] == parent && "parent must belong to this scene");
+				next_sibling[i-1] = first_child[parent->flat_index];
+				first_child[parent->flat_index] = i-1;
+			}
+		}
+
+		//depth-first traversal from the roots, so parents come first and subtrees are contiguous:
+		struct Entry {
+			uint32_t index; //in 'unsorted'
+			uint32_t parent; //in 'flat'
+		};
+		std::vector< Entry > stack;
+		for (uint32_t i = uint32_t(unsorted.size()); i > 0; --i) {
+			if (unsorted[i-1]->parent == nullptr) stack.emplace_back(Entry{i-1, -1U});
+		}
+		flat.transforms.clear();
+		flat.parents.clear();
+		while (!stack.empty()) {
+			Entry entry = stack.back();
+			stack.pop_back();
+			uint32_t at = uint32_t(flat.transforms.size());
+			flat.transforms.emplace_back(unsorted[entry.index]);
+			flat.parents.emplace_back(entry.parent);
+			for (uint32_t c = first_child[entry.index]; c != -1U; c = next_sibling[c]) {
+				stack.emplace_back(Entry{c, at});
+			}
+		}
+		assert(flat.transforms.size() == unsorted.size() && "transform hierarchy should not contain cycles");
+
+		for (uint32_t i = 0; i < flat.transforms.size(); ++i) {
+			flat.transforms[i]->flat_index = i;
+		}
+		flat.positions.resize(flat.transforms.size());
+		flat.rotations.resize(flat.transforms.size());
+		flat.scales.resize(flat.transforms.size());
+		flat.local_to_world.resize(flat.transforms.size());
+		flat.world_to_local.resize(flat.transforms.size());
+		//(mismatched stamps make the pass below fill every entry)
+		flat.stamps.assign(flat.transforms.size(), 0);
+		for (uint32_t i = 0; i < flat.transforms.size(); ++i) {
+			flat.stamps[i] = flat.transforms[i]->cache.stamp - 1;
+		}
+		flat.sorted = true;
+	}
+
+	//find what changed (or had an ancestor change), parents before children:
+	flat.dirty.clear();
+	for (uint32_t i = 0; i < flat.transforms.size(); ++i) {
+		Transform *t = flat.transforms[i];
+		uint32_t p = flat.parents[i];
+		uint32_t parent_stamp = (p == -1U ? 0 : flat.transforms[p]->cache.stamp);
+
+		flat.positions[i] = t->position;
+		flat.rotations[i] = t->rotation;
+		flat.scales[i] = t->scale;
+
+		if (t->cache.dirty
+		 || t->cache.parent_stamp != parent_stamp
+		 || t->cache.position != flat.positions[i]
+		 || t->cache.rotation != flat.rotations[i]
+		 || t->cache.scale != flat.scales[i]) {
+			//needs recomputing (below); bump the stamp now so children notice:
+			flat.dirty.emplace_back(i);
+			t->cache.position = flat.positions[i];
+			t->cache.rotation = flat.rotations[i];
+			t->cache.scale = flat.scales[i];
+			t->cache.parent_stamp = parent_stamp;
+			t->cache.dirty = false;
+			t->cache.stamp += 1;
+		} else if (flat.stamps[i] != t->cache.stamp) {
+			//cache was rebuilt on demand since the last pass -- pick up its matrices:
+			flat.local_to_world[i] = t->cache.local_to_world;
+			flat.world_to_local[i] = t->cache.world_to_local;
+		}
+		flat.stamps[i] = t->cache.stamp;
+	}
+
+	if (flat.dirty.empty()) return;
+
+	//local matrices for everything that changed, in one batch:
+	flat.dirty_local_to_parent.resize(flat.dirty.size());
+	flat.dirty_parent_to_local.resize(flat.dirty.size());
+	make_local_to_parent(uint32_t(flat.dirty.size()), flat.positions.data(), flat.rotations.data(), flat.scales.data(), flat.dirty_local_to_parent.data(), flat.dirty.data());
+	make_parent_to_local(uint32_t(flat.dirty.size()), flat.positions.data(), flat.rotations.data(), flat.scales.data(), flat.dirty_parent_to_local.data(), flat.dirty.data());
+
+	//compose with parents (still parents before children):
+	for (uint32_t d = 0; d < flat.dirty.size(); ++d) {
+		uint32_t i = flat.dirty[d];
+		uint32_t p = flat.parents[i];
+		if (p == -1U) {
+			flat.local_to_world[i] = flat.dirty_local_to_parent[d];
+			flat.world_to_local[i] = flat.dirty_parent_to_local[d];
+		} else {
+			flat.local_to_world[i] = multiply_affine(flat.local_to_world[p], flat.dirty_local_to_parent[d]);
+			flat.world_to_local[i] = multiply_affine(flat.dirty_parent_to_local[d], flat.world_to_local[p]);
+		}
+
+		//write back to the handle so make_local_to_world() agrees:
+		Transform *t = flat.transforms[i];
+		t->cache.local_to_world = flat.local_to_world[i];
+		t->cache.world_to_local = flat.world_to_local[i];
+	}
+}
+
+glm::mat4 const &Scene::local_to_world(Transform const *transform) const {
+	if (transform_storage == TransformStorageFlat) {
+		assert(flat.sorted && transform->flat_index < flat.transforms.size() && flat.transforms[transform->flat_index] == transform);
+		return flat.local_to_world[transform->flat_index];
+	} else {
+		transform->update_cache();
+		return transform->cache.local_to_world;
+	}
+}
+
+glm::mat4 const &Scene::world_to_local(Transform const *transform) const {
+	if (transform_storage == TransformStorageFlat) {
+		assert(flat.sorted && transform->flat_index < flat.transforms.size() && flat.transforms[transform->flat_index] == transform);
+		return flat.world_to_local[transform->flat_index];
+	} else {
+		transform->update_cache();
+		return transform->cache.world_to_local;
+	}
+}
+
+//---------------------------
+//static batching:
+
+void Scene::bake_static(Transform *root, std::function< bool(Object const *) > const &keep_dynamic, float chunk_size) {
+	assert(chunk_size >= 0.0f && "chunk size is a length (or zero for no chunks)");
+
+	if (transform_storage == TransformStorageFlat) {
+		update_transforms();
+	}
+
+	//group bakeable objects in the subtree:
+	struct Key {
+		MeshBuffer const *buffer;
+		GLuint program;
+		uint32_t material;
+		glm::ivec3 cell; //(all zero without chunks)
+		bool operator<(Key const &o) const {
+			if (buffer != o.buffer) return buffer < o.buffer;
+			if (program != o.program) return program < o.program;
+			if (material != o.material) return material < o.material;
+			if (cell.x != o.cell.x) return cell.x < o.cell.x;
+			if (cell.y != o.cell.y) return cell.y < o.cell.y;
+			return cell.z < o.cell.z;
+		}
+	};
+	std::map< Key, std::vector< Object * > > groups;
+	for (Object *object = first_object; object != nullptr; object = object->alloc_next) {
+		if (!object->mesh_buffer) continue;
+		if (keep_dynamic && keep_dynamic(object)) continue;
+		bool in_subtree = (root == nullptr);
+		for (Transform const *t = object->transform; t != nullptr && !in_subtree; t = t->parent) {
+			if (t == root) {
+				in_subtree = true;
+				break;
+			}
+		}
+		if (!in_subtree) continue;
+		if ((object->lods.empty() ? object->count : object->lods[0].count) == 0) continue;
+		if (!object->lods.empty()) { //bake the full-detail mesh
+			object->lod = 0;
+			object->start = object->lods[0].start;
+			object->count = object->lods[0].count;
+		}
+		glm::ivec3 cell = glm::ivec3(0);
+		if (chunk_size > 0.0f) {
+			glm::vec3 center = glm::vec3(local_to_world(object->transform) * glm::vec4(0.5f * (object->bounds_min + object->bounds_max), 1.0f));
+			cell = glm::ivec3(glm::floor(center / chunk_size));
+		}
+		groups[Key{object->mesh_buffer, object->program, object->material, cell}].emplace_back(object);
+	}
+	if (groups.empty()) return;
+
+	//baked objects live in world space:
+	Transform *baked_transform = new_transform();
+	if (transform_storage == TransformStorageFlat) {
+		update_transforms(); //(re-sort, so local_to_world() below still finds the sources' matrices)
+	}
+
+	//one merged buffer per source buffer (groups with the same source are adjacent in the map):
+	for (auto begin = groups.begin(); begin != groups.end(); ) {
+		MeshBuffer const &source = *begin->first.buffer;
+		auto end = begin;
+		while (end != groups.end() && end->first.buffer == &source) ++end;
+
+		assert(source.Position.size == 3 && source.Position.type == GL_FLOAT && "baking expects float positions");
+		assert((source.Normal.size == 0 || (source.Normal.size == 3 && source.Normal.type == GL_FLOAT)) && "baking expects float normals");
+		uint32_t stride = uint32_t(source.Position.stride);
+
+		std::vector< uint8_t > data;
+		std::vector< MeshBuffer::Mesh > meshes;
+		for (auto g = begin; g != end; ++g) {
+			MeshBuffer::Mesh mesh;
+			mesh.start = GLuint(data.size() / stride);
+			bool first = true;
+			for (Object const *object : g->second) {
+				assert((object->start + object->count) * stride <= source.vertex_data.size() && "object range is inside its buffer");
+				glm::mat4 const &to_world = local_to_world(object->transform);
+				glm::mat3 normal_to_world = make_normal_matrix(to_world);
+
+				uint32_t at = uint32_t(data.size());
+				data.insert(data.end(), source.vertex_data.begin() + object->start * stride, source.vertex_data.begin() + (object->start + object->count) * stride);
+				for (uint32_t v = 0; v < object->count; ++v) {
+					uint8_t *vertex = &data[at + v * stride];
+					glm::vec3 position;
+					std::memcpy(&position, vertex + source.Position.offset, sizeof(position));
+					position = glm::vec3(to_world * glm::vec4(position, 1.0f));
+					std::memcpy(vertex + source.Position.offset, &position, sizeof(position));
+					if (source.Normal.size) {
+						glm::vec3 normal;
+						std::memcpy(&normal, vertex + source.Normal.offset, sizeof(normal));
+						normal = glm::normalize(normal_to_world * normal);
+						std::memcpy(vertex + source.Normal.offset, &normal, sizeof(normal));
+					}
+					if (first) {
+						mesh.min = mesh.max = position;
+						first = false;
+					} else {
+						mesh.min = glm::min(mesh.min, position);
+						mesh.max = glm::max(mesh.max, position);
+					}
+				}
+			}
+			mesh.count = GLuint(data.size() / stride) - mesh.start;
+			mesh.center = 0.5f * (mesh.min + mesh.max);
+			float radius2 = 0.0f;
+			for (GLuint v = mesh.start; v < mesh.start + mesh.count; ++v) {
+				glm::vec3 position;
+				std::memcpy(&position, &data[v * stride + source.Position.offset], sizeof(position));
+				radius2 = std::max(radius2, glm::dot(position - mesh.center, position - mesh.center));
+			}
+			mesh.radius = std::sqrt(radius2);
+			meshes.emplace_back(mesh);
+		}
+
+		static_buffers.emplace_back(new MeshBuffer(source, data));
+		MeshBuffer const *baked = static_buffers.back().get();
+
+		//replace each group with one object drawing its merged range:
+		std::map< GLuint, GLuint > vao_for_program;
+		uint32_t m = 0;
+		for (auto g = begin; g != end; ++g, ++m) {
+			Object const *model = g->second[0];
+			if (vao_for_program.find(model->program) == vao_for_program.end()) {
+				GLuint vao = baked->make_vao_for_program(model->program);
+				vao_for_program[model->program] = vao;
+				static_vaos.emplace_back(vao);
+			}
+
+			Object *object = new_object(baked_transform);
+			object->program = model->program;
+			object->program_mvp_mat4 = model->program_mvp_mat4;
+			object->program_mv_mat4x3 = model->program_mv_mat4x3;
+			object->program_itmv_mat3 = model->program_itmv_mat3;
+			object->uniform_blocks = model->uniform_blocks;
+			object->material = model->material;
+			object->vao = vao_for_program[model->program];
+			object->mesh_buffer = baked;
+			object->set_mesh(meshes[m]);
+
+			for (Object *old : g->second) {
+				delete_object(old);
+			}
+		}
+
+		begin = end;
+	}
+}
+
+//---------------------------
+//materials:
+
+uint32_t Scene::new_material() {
+	Material material;
+	material.begin = material.end = uint32_t(material_uniforms.size());
+	materials.emplace_back(material);
+	return uint32_t(materials.size()) - 1;
+}
+
+float *Scene::material_value(uint32_t material, GLint location, MaterialUniform::Type type) {
+	assert(material != 0 && material < materials.size() && "material was made by new_material()");
+	Material &m = materials[material];
+	for (uint32_t u = m.begin; u < m.end; ++u) {
+		if (material_uniforms[u].location == location) {
+			assert(material_uniforms[u].type == type && "uniform keeps its type");
+			return &material_values[material_uniforms[u].value];
+		}
+	}
+
+	//add a new uniform (only at the end of the table, which keeps each material's uniforms contiguous):
+	assert(material + 1 == materials.size() && "uniforms can only be added to the newest material");
+	static uint32_t const Sizes[] = {1, 3, 4, 16};
+	MaterialUniform uniform;
+	uniform.type = type;
+	uniform.location = location;
+	uniform.value = uint32_t(material_values.size());
+	material_uniforms.emplace_back(uniform);
+	material_values.resize(material_values.size() + Sizes[type], 0.0f);
+	m.end = uint32_t(material_uniforms.size());
+	return &material_values[uniform.value];
+}
+
+void Scene::set_material_uniform(uint32_t material, GLint location, float value) {
+	*material_value(material, location, MaterialUniform::Float) = value;
+}
+
+void Scene::set_material_uniform(uint32_t material, GLint location, glm::vec3 const &value) {
+	std::memcpy(material_value(material, location, MaterialUniform::Vec3), &value, sizeof(value));
+}
+
+void Scene::set_material_uniform(uint32_t material, GLint location, glm::vec4 const &value) {
+	std::memcpy(material_value(material, location, MaterialUniform::Vec4), &value, sizeof(value));
+}
+
+void Scene::set_material_uniform(uint32_t material, GLint location, glm::mat4 const &value) {
+	std::memcpy(material_value(material, location, MaterialUniform::Mat4), &value, sizeof(value));
+}
+
+//---------------------------
+//occlusion culling:
+
+void Scene::add_occluder(Scene::Object const *object) {
+	assert(object && object->mesh_buffer && "occluders read triangles from the object's mesh buffer");
+	assert(object->mesh_buffer->Position.size == 3 && object->mesh_buffer->Position.type == GL_FLOAT && "occluders need float positions");
+	Occluder occluder;
+	occluder.transform = object->transform;
+	occluder.mesh_buffer = object->mesh_buffer;
+	occluder.start = object->lods.empty() ? object->start : object->lods[0].start; //(coarser levels might bulge past the real surface)
+	occluder.count = object->lods.empty() ? object->count : object->lods[0].count;
+	occluder.bounds_min = object->bounds_min;
+	occluder.bounds_max = object->bounds_max;
+	occluders.emplace_back(occluder);
+}
+
+//---------------------------
+//spatial index:
+
+namespace {
+	float surface_area(glm::vec3 const &min, glm::vec3 const &max) {
+		glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	//conservative test of a sphere against a cone (apex, unit direction, half-angle given by cos/sin, range):
+	bool sphere_touches_cone(glm::vec3 const &apex, glm::vec3 const &direction, float cos_angle, float sin_angle, float range, glm::vec3 const &center, float radius) {
+		glm::vec3 v = center - apex;
+		float length2 = glm::dot(v, v);
+		if (length2 > (range + radius) * (range + radius)) return false; //out of range
+		if (length2 <= radius * radius) return true; //apex inside sphere
+		float along = glm::dot(v, direction);
+		float perp = std::sqrt(std::max(0.0f, length2 - along * along));
+		//nearest point of the cone is the apex, which is out of reach:
+		if (along * cos_angle + perp * sin_angle < 0.0f) return false;
+		//otherwise, compare against distance to the cone's surface:
+		return perp * cos_angle - along * sin_angle <= radius;
+	}
+
+	//depth of the fixed-size traversal stacks used by queries (leaves hold a few objects and splits are at the median, so this is ample):
+	uint32_t const SpatialStackSize = 64;
+	uint32_t const SpatialLeafSize = 4;
+}
+
+void Scene::update_spatial_index() {
+	if (transform_storage == TransformStorageFlat) {
+		update_transforms();
+	}
+
+	//node spheres, bottom up (a sphere around a child's box can poke out of the sphere around its parent's box, so they are fit separately):
+	auto fit_spheres = [this]() {
+		for (uint32_t n = uint32_t(spatial.nodes.size()); n > 0; --n) {
+			auto &node = spatial.nodes[n-1];
+			glm::vec3 center = 0.5f * (node.min + node.max);
+			node.radius = 0.0f;
+			if (node.count) {
+				for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+					glm::vec3 const &min = spatial.mins[i];
+					glm::vec3 const &max = spatial.maxs[i];
+					node.radius = std::max(node.radius, glm::length(0.5f * (min + max) - center) + 0.5f * glm::length(max - min));
+				}
+			} else {
+				for (uint32_t c = node.first; c < node.first + 2; ++c) {
+					auto const &child = spatial.nodes[c];
+					node.radius = std::max(node.radius, glm::length(0.5f * (child.min + child.max) - center) + child.radius);
+				}
+			}
+		}
+	};
+
+	//objects that gained or lost bounds (e.g., through set_mesh) belong in the other list:
+	if (spatial.built) {
+		for (Object const *object : spatial.objects) {
+			if (object->bounds_radius < 0.0f) spatial.built = false;
+		}
+		for (Object const *object : spatial.unbounded) {
+			if (object->bounds_radius >= 0.0f) spatial.built = false;
+		}
+	}
+
+	if (!spatial.built) {
+		spatial.objects.clear();
+		spatial.unbounded.clear();
+		for (Object *object = first_object; object != nullptr; object = object->alloc_next) {
+			if (object->bounds_radius < 0.0f) spatial.unbounded.emplace_back(object);
+			else spatial.objects.emplace_back(object);
+		}
+	}
+
+	//world bounds of every object:
+	spatial.mins.resize(spatial.objects.size());
+	spatial.maxs.resize(spatial.objects.size());
+	for (uint32_t i = 0; i < spatial.objects.size(); ++i) {
+		glm::vec3 center, extent;
+		object_box(*spatial.objects[i], local_to_world(spatial.objects[i]->transform), &center, &extent);
+		spatial.mins[i] = center - extent;
+		spatial.maxs[i] = center + extent;
+	}
+
+	if (spatial.built) {
+		//refit: children come after parents, so walk backward:
+		float area = 0.0f;
+		for (uint32_t n = uint32_t(spatial.nodes.size()); n > 0; --n) {
+			auto &node = spatial.nodes[n-1];
+			if (node.count) {
+				node.min = spatial.mins[node.first];
+				node.max = spatial.maxs[node.first];
+				for (uint32_t i = node.first + 1; i < node.first + node.count; ++i) {
+					node.min = glm::min(node.min, spatial.mins[i]);
+					node.max = glm::max(node.max, spatial.maxs[i]);
+				}
+			} else {
+				node.min = glm::min(spatial.nodes[node.first].min, spatial.nodes[node.first+1].min);
+				node.max = glm::max(spatial.nodes[node.first].max, spatial.nodes[node.first+1].max);
+			}
+			area += surface_area(node.min, node.max);
+		}
+		//objects moved enough that the tree no longer fits them well:
+		if (area > 2.0f * spatial.built_area) spatial.built = false;
+	}
+
+	if (spatial.built) {
+		fit_spheres();
+		return;
+	}
+
+	//rebuild, top-down, splitting the longest axis at the median:
+	std::vector< uint32_t > order(spatial.objects.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	spatial.nodes.clear();
+	spatial.built_area = 0.0f;
+	if (!order.empty()) {
+		struct Range {
+			uint32_t node;
+			uint32_t begin, end; //in 'order'
+		};
+		std::vector< Range > todo;
+		spatial.nodes.emplace_back();
+		todo.emplace_back(Range{0, 0, uint32_t(order.size())});
+		while (!todo.empty()) {
+			Range range = todo.back();
+			todo.pop_back();
+
+			glm::vec3 min = spatial.mins[order[range.begin]];
+			glm::vec3 max = spatial.maxs[order[range.begin]];
+			for (uint32_t i = range.begin + 1; i < range.end; ++i) {
+				min = glm::min(min, spatial.mins[order[i]]);
+				max = glm::max(max, spatial.maxs[order[i]]);
+			}
+			spatial.nodes[range.node].min = min;
+			spatial.nodes[range.node].max = max;
+			spatial.built_area += surface_area(min, max);
+
+			if (range.end - range.begin <= SpatialLeafSize) {
+				spatial.nodes[range.node].first = range.begin;
+				spatial.nodes[range.node].count = range.end - range.begin;
+				continue;
+			}
+
+			glm::vec3 size = max - min;
+			uint32_t axis = (size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2));
+			uint32_t mid = (range.begin + range.end) / 2;
+			auto const &mins = spatial.mins;
+			auto const &maxs = spatial.maxs;
+			std::nth_element(order.begin() + range.begin, order.begin() + mid, order.begin() + range.end, [&](uint32_t a, uint32_t b) {
+				return mins[a][axis] + maxs[a][axis] < mins[b][axis] + maxs[b][axis];
+			});
+
+			uint32_t child = uint32_t(spatial.nodes.size());
+			spatial.nodes[range.node].first = child;
+			spatial.nodes[range.node].count = 0;
+			spatial.nodes.emplace_back();
+			spatial.nodes.emplace_back();
+			todo.emplace_back(Range{child, range.begin, mid});
+			todo.emplace_back(Range{child + 1, mid, range.end});
+		}
+	}
+
+	//put objects in leaf order:
+	std::vector< Object * > objects(order.size());
+	std::vector< glm::vec3 > mins(order.size());
+	std::vector< glm::vec3 > maxs(order.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		objects[i] = spatial.objects[order[i]];
+		mins[i] = spatial.mins[order[i]];
+		maxs[i] = spatial.maxs[order[i]];
+	}
+	spatial.objects.swap(objects);
+	spatial.mins.swap(mins);
+	spatial.maxs.swap(maxs);
+	spatial.built = true;
+	fit_spheres();
+}
+
+void Scene::query_radius(glm::vec3 const &point, float radius, std::vector< Object * > *out) const {
+	assert(out);
+	out->insert(out->end(), spatial.unbounded.begin(), spatial.unbounded.end());
+	if (spatial.nodes.empty()) return;
+
+	float radius2 = radius * radius;
+	auto touches = [&](glm::vec3 const &min, glm::vec3 const &max) {
+		glm::vec3 d = point - glm::clamp(point, min, max);
+		return glm::dot(d, d) <= radius2;
+	};
+
+	uint32_t stack[SpatialStackSize];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top) {
+		auto const &node = spatial.nodes[stack[--top]];
+		if (!touches(node.min, node.max)) continue;
+		if (node.count) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				if (touches(spatial.mins[i], spatial.maxs[i])) out->emplace_back(spatial.objects[i]);
+			}
+		} else {
+			assert(top + 2 <= SpatialStackSize);
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+}
+
+void Scene::query_cone(glm::vec3 const &apex, glm::vec3 const &direction, float half_angle, float range, std::vector< Object * > *out) const {
+	assert(out);
+	out->insert(out->end(), spatial.unbounded.begin(), spatial.unbounded.end());
+	if (spatial.nodes.empty()) return;
+
+	float cos_angle = std::cos(half_angle);
+	float sin_angle = std::sin(half_angle);
+	auto touches = [&](glm::vec3 const &center, float radius) {
+		return sphere_touches_cone(apex, direction, cos_angle, sin_angle, range, center, radius);
+	};
+
+	uint32_t stack[SpatialStackSize];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top) {
+		auto const &node = spatial.nodes[stack[--top]];
+		if (!touches(0.5f * (node.min + node.max), node.radius)) continue;
+		if (node.count) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				glm::vec3 const &min = spatial.mins[i];
+				glm::vec3 const &max = spatial.maxs[i];
+				if (touches(0.5f * (min + max), 0.5f * glm::length(max - min))) out->emplace_back(spatial.objects[i]);
+			}
+		} else {
+			assert(top + 2 <= SpatialStackSize);
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+}
+
+//---------------------------
+
 void Scene::draw(Scene::Camera const *camera) {
-	assert(camera && "Must have a camera to draw scene from.");
+	prepare(camera);
+	submit();
+}
 
-	glm::mat4 world_to_camera = camera->transform->make_world_to_local();
-	glm::mat4 world_to_clip = camera->make_projection() * world_to_camera;
+void Scene::draw(std::vector< Scene::Camera const * > const &cameras, std::vector< glm::ivec4 > const &viewports) {
+	prepare(cameras, viewports);
+	submit();
+}
 
+void Scene::prepare(Scene::Camera const *camera) {
+	prepare(std::vector< Camera const * >(1, camera), std::vector< glm::ivec4 >(1, glm::ivec4(0)));
+}
+
+void Scene::prepare(std::vector< Scene::Camera const * > const &cameras, std::vector< glm::ivec4 > const &viewports) {
+	assert(!cameras.empty() && "Must have a camera to draw scene from.");
+	assert(cameras.size() == viewports.size() && "Each camera has a viewport.");
+	for (auto camera : cameras) {
+		assert(camera && "Must have a camera to draw scene from.");
+	}
+
+	//work shared by all views -- world matrices, subtree bounds, and gathering:
+	if (transform_storage == TransformStorageFlat) {
+		update_transforms();
+	}
+
+	bool hierarchical = frustum_culling && transform_storage == TransformStorageFlat;
+	if (hierarchical) {
+		//gather object bounds into their transforms, then into ancestors (children come after parents):
+		flat.subtree_centers.assign(flat.transforms.size(), glm::vec3(0.0f));
+		flat.subtree_radii.assign(flat.transforms.size(), -1.0f);
+		for (Scene::Object *object = first_object; object != nullptr; object = object->alloc_next) {
+			uint32_t i = object->transform->flat_index;
+			glm::vec3 center;
+			float radius;
+			object_sphere(*object, flat.local_to_world[i], &center, &radius);
+			merge_sphere(flat.subtree_centers[i], flat.subtree_radii[i], center, radius);
+		}
+		for (uint32_t i = uint32_t(flat.transforms.size()); i > 0; --i) {
+			uint32_t p = flat.parents[i-1];
+			if (p != -1U) merge_sphere(flat.subtree_centers[p], flat.subtree_radii[p], flat.subtree_centers[i-1], flat.subtree_radii[i-1]);
+		}
+	}
+
+	//gather objects and occluders with their world matrices:
+	// (this stays serial because, with linked storage, it may rebuild shared ancestor caches)
+	views.resize(cameras.size());
+	std::vector< DrawItem > &gathered = views[0].draw_list;
+	gathered.clear();
 	for (Scene::Object *object = first_object; object != nullptr; object = object->alloc_next) {
-		glm::mat4 local_to_world = object->transform->make_local_to_world();
+		gathered.emplace_back(DrawItem{object, &this->local_to_world(object->transform), object->lods.data(), uint32_t(object->lods.size()), 0.0f, 0, object->start, object->count});
+	}
+	for (uint32_t v = 1; v < views.size(); ++v) {
+		views[v].draw_list = gathered;
+	}
+	occluder_matrices.clear();
+	if (occlusion_culling) {
+		for (auto const &occluder : occluders) {
+			occluder_matrices.emplace_back(this->local_to_world(occluder.transform));
+		}
+	}
+
+	//world matrices of the cameras (with linked storage, these may also rebuild caches, so stay serial):
+	std::vector< glm::mat4 > world_to_cameras;
+	world_to_cameras.reserve(cameras.size());
+	for (auto camera : cameras) {
+		world_to_cameras.emplace_back(world_to_local(camera->transform));
+	}
+
+	fetch_uniform_alignment();
+
+	//each view's own culling and layout, with views running side by side:
+	uint32_t threads = worker_threads;
+	if (threads == 0) threads = std::max(1U, std::thread::hardware_concurrency());
+	uint32_t threads_per_view = std::max(1U, threads / uint32_t(views.size()));
+	parallel_for(uint32_t(views.size()), threads, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t v = begin; v < end; ++v) {
+			views[v].viewport = viewports[v];
+			prepare_draw_list(views[v], world_to_cameras[v], cameras[v]->make_projection(), cameras[v]->fovy, cameras[v]->near,
+				frame_block, occluder_matrices, hierarchical, threads_per_view);
+		}
+	});
 
-		//compute modelview+projection (object space to clip space) matrix for this object:
-		glm::mat4 mvp = world_to_clip * local_to_world;
+	//the main view's levels of detail are what next frame's hysteresis works from:
+	for (auto const &item : views[0].draw_list) {
+		item.object->lod = item.lod;
+	}
+}
 
-		//compute modelview (object space to camera local space) matrix for this object:
-		glm::mat4 mv = local_to_world;
+void Scene::prepare_draw_list(View &view, glm::mat4 const &world_to_camera, glm::mat4 const &projection, float fovy, float near,
+	FrameBlock const &frame, std::vector< glm::mat4 > const &occluder_to_world, bool hierarchical, uint32_t threads) {
+	glm::mat4 world_to_clip = projection * world_to_camera;
+	Frustum frustum(world_to_clip);
 
-		//NOTE: inverse cancels out transpose unless there is scale involved
-		glm::mat3 itmv = glm::inverse(glm::transpose(glm::mat3(mv)));
+	std::vector< DrawItem > &draw_list = view.draw_list;
+	std::vector< uint8_t > &draw_visible = view.draw_visible;
+	std::vector< DrawCommand > &draw_commands = view.draw_commands;
 
-		//set up program uniforms:
-		glUseProgram(object->program);
-		if (object->program_mvp_mat4 != -1U) {
-			glUniformMatrix4fv(object->program_mvp_mat4, 1, GL_FALSE, glm::value_ptr(mvp));
+	if (hierarchical) {
+		//classify subtrees; a subtree entirely inside or outside settles all of its descendants:
+		std::vector< uint8_t > &visibility = view.subtree_visibility;
+		visibility.resize(flat.transforms.size());
+		for (uint32_t i = 0; i < flat.transforms.size(); ++i) {
+			uint32_t p = flat.parents[i];
+			if (p != -1U && visibility[p] != Intersecting) {
+				visibility[i] = visibility[p];
+			} else {
+				visibility[i] = classify_sphere(frustum, flat.subtree_centers[i], flat.subtree_radii[i]);
+			}
 		}
-		if (object->program_mv_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(object->program_mv_mat4x3, 1, GL_FALSE, glm::value_ptr(mv));
+	}
+
+	//projected sphere diameter (as a fraction of viewport height) is radius / depth times this:
+	float lod_size_scale = 1.0f / std::tan(0.5f * fovy);
+
+	//cull and compute depths (in parallel):
+	draw_visible.resize(draw_list.size());
+	parallel_for(uint32_t(draw_list.size()), threads, objects_per_worker, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			DrawItem &item = draw_list[i];
+			Scene::Drawable const *object = item.object;
+			glm::mat4 const &local_to_world = *item.local_to_world;
+
+			draw_visible[i] = 1;
+			if (frustum_culling) {
+				Visibility vis = Intersecting;
+				if (hierarchical) vis = Visibility(view.subtree_visibility[static_cast< Scene::Object const * >(object)->transform->flat_index]); //(only live objects are culled hierarchically)
+				if (vis == Outside
+				 || (vis == Intersecting && object_outside(frustum, *object, local_to_world))) {
+					draw_visible[i] = 0;
+					continue;
+				}
+			}
+
+			glm::vec3 center = (object->bounds_radius < 0.0f ? glm::vec3(0.0f) : object->bounds_center);
+			item.depth = -(world_to_camera * (local_to_world * glm::vec4(center, 1.0f))).z;
+
+			if (item.lod_count != 0) {
+				uint32_t lod = std::min(object->lod, item.lod_count - 1);
+				if (object->bounds_radius >= 0.0f) {
+					glm::vec3 world_center;
+					float world_radius;
+					object_sphere(*object, local_to_world, &world_center, &world_radius);
+					float size = lod_size_scale * world_radius / std::max(item.depth, near);
+					uint32_t coarser = lod_level(size * (1.0f + lod_hysteresis), lod_screen_size, item.lod_count);
+					uint32_t finer = lod_level(size * (1.0f - lod_hysteresis), lod_screen_size, item.lod_count);
+					if (coarser > lod) lod = coarser;
+					else if (finer < lod) lod = finer;
+				}
+				//(the object keeps the main view's choice; see prepare())
+				item.lod = lod;
+				item.start = item.lods[lod].start;
+				item.count = item.lods[lod].count;
+			}
 		}
-		if (object->program_itmv_mat3 != -1U) {
-			glUniformMatrix3fv(object->program_itmv_mat3, 1, GL_FALSE, glm::value_ptr(itmv));
+	});
+
+	//keep only visible objects:
+	uint32_t visible = 0;
+	for (uint32_t i = 0; i < draw_list.size(); ++i) {
+		if (draw_visible[i]) draw_list[visible++] = draw_list[i];
+	}
+	draw_list.resize(visible);
+
+	//rasterize occluders and drop whatever they hide:
+	if (occlusion_culling && !occluders.empty()) {
+		assert(occluder_to_world.size() == occluders.size() && "occluder matrices line up with occluders");
+		view.occlusion.clear();
+		for (uint32_t o = 0; o < occluders.size(); ++o) {
+			Occluder const &occluder = occluders[o];
+			glm::mat4 const &to_world = occluder_to_world[o];
+			if (frustum_culling) {
+				glm::vec3 center = glm::vec3(to_world * glm::vec4(0.5f * (occluder.bounds_min + occluder.bounds_max), 1.0f));
+				glm::vec3 extent = glm::mat3(
+					glm::abs(glm::vec3(to_world[0])),
+					glm::abs(glm::vec3(to_world[1])),
+					glm::abs(glm::vec3(to_world[2]))
+				) * (0.5f * (occluder.bounds_max - occluder.bounds_min));
+				if (box_outside(frustum, center, extent)) continue;
+			}
+			MeshBuffer const &buffer = *occluder.mesh_buffer;
+			uint32_t stride = uint32_t(buffer.Position.stride);
+			assert((occluder.start + occluder.count) * stride <= buffer.vertex_data.size() && "occluder range is inside its buffer");
+			view.occlusion.rasterize_triangles(world_to_clip * to_world, buffer.vertex_data.data() + occluder.start * stride + buffer.Position.offset, stride, occluder.count);
 		}
+		view.occlusion.build_pyramid();
 
-		if (object->set_uniforms) object->set_uniforms();
+		visible = 0;
+		for (uint32_t i = 0; i < draw_list.size(); ++i) {
+			Scene::Drawable const *object = draw_list[i].object;
+			if (object->bounds_radius >= 0.0f) {
+				glm::vec3 center, extent;
+				object_box(*object, *draw_list[i].local_to_world, &center, &extent);
+				if (view.occlusion.box_occluded(world_to_clip, center - extent, center + extent)) continue;
+			}
+			draw_list[visible++] = draw_list[i];
+		}
+		draw_list.resize(visible);
+	}
 
-		glBindVertexArray(object->vao);
+	//sort to group state changes; within a group, draw front-to-back to reduce overdraw:
+	std::sort(draw_list.begin(), draw_list.end(), [](DrawItem const &a, DrawItem const &b) {
+		if (a.object->program != b.object->program) return a.object->program < b.object->program;
+		if (a.object->vao != b.object->vao) return a.object->vao < b.object->vao;
+		if (a.object->material != b.object->material) return a.object->material < b.object->material;
+		//instanceable objects group by mesh range, so each instanced run ends up adjacent:
+		bool a_instanceable = (a.object->instanced_program != 0 && a.object->material == 0);
+		bool b_instanceable = (b.object->instanced_program != 0 && b.object->material == 0);
+		if (a_instanceable != b_instanceable) return a_instanceable < b_instanceable;
+		if (a_instanceable) {
+			if (a.object->instanced_program != b.object->instanced_program) return a.object->instanced_program < b.object->instanced_program;
+			if (a.object->instanced_vao != b.object->instanced_vao) return a.object->instanced_vao < b.object->instanced_vao;
+			if (a.start != b.start) return a.start < b.start;
+			if (a.count != b.count) return a.count < b.count;
+		}
+		return a.depth < b.depth;
+	});
 
-		//draw the object:
-		glDrawArrays(GL_TRIANGLES, object->start, object->count);
+	//group runs of objects that can share an instanced draw into commands:
+	draw_commands.clear();
+	for (uint32_t begin = 0; begin < draw_list.size(); ) {
+		DrawItem const &item = draw_list[begin];
+		Scene::Drawable const *object = item.object;
+		uint32_t end = begin + 1;
+		if (object->instanced_program != 0 && object->material == 0) {
+			while (end < draw_list.size()) {
+				Scene::Drawable const *other = draw_list[end].object;
+				if (other->program != object->program
+				 || other->vao != object->vao
+				 || other->material != object->material
+				 || draw_list[end].start != item.start
+				 || draw_list[end].count != item.count
+				 || other->instanced_program != object->instanced_program
+				 || other->instanced_vao != object->instanced_vao) break;
+				++end;
+			}
+		}
+		DrawCommand command;
+		command.block_offset = -1U;
+		if (object->instanced_program != 0 && object->material == 0 && end - begin >= min_instances) {
+			command.begin = begin;
+			command.end = end;
+			command.instanced = true;
+			draw_commands.emplace_back(command);
+		} else {
+			//(non-instanced runs become single-object commands)
+			command.instanced = false;
+			for (uint32_t i = begin; i < end; ++i) {
+				command.begin = i;
+				command.end = i + 1;
+				draw_commands.emplace_back(command);
+			}
+		}
+		begin = end;
+	}
+
+	//lay out this view's uniform data: frame block, then object blocks for non-instanced objects that use them:
+	// (the alignment was fetched by prepare() or prepare_snapshot(), before any views ran)
+	assert(uniform_stream.alignment > 0 && "uniform buffer alignment is known");
+	uint32_t alignment = uint32_t(uniform_stream.alignment);
+	auto align = [alignment](uint32_t offset) {
+		return (offset + alignment - 1) / alignment * alignment;
+	};
+	uint32_t size = align(sizeof(FrameBlock));
+	for (auto &command : draw_commands) {
+		if (command.instanced || !draw_list[command.begin].object->uniform_blocks) continue;
+		command.block_offset = size;
+		size += align(sizeof(ObjectBlock));
+	}
+	view.uniform_data.resize(size);
+	FrameBlock block = frame;
+	block.world_to_clip = world_to_clip;
+	std::memcpy(&view.uniform_data[0], &block, sizeof(FrameBlock));
+
+	//compute every command's matrices (in parallel):
+	// (instance records line up with draw_list, so each instanced command reads a contiguous range)
+	std::vector< Instance > &instances = view.instances;
+	instances.resize(draw_list.size());
+	parallel_for(uint32_t(draw_commands.size()), threads, objects_per_worker, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t c = begin; c < end; ++c) {
+			DrawCommand &command = draw_commands[c];
+			if (command.instanced) {
+				for (uint32_t i = command.begin; i < command.end; ++i) {
+					glm::mat4 const &local_to_world = *draw_list[i].local_to_world;
+					Instance &instance = instances[i];
+					instance.object_to_clip = world_to_clip * local_to_world;
+					instance.object_to_light = glm::mat4x3(local_to_world);
+					instance.normal_to_light = make_normal_matrix(local_to_world);
+				}
+				continue;
+			}
+
+			glm::mat4 const &local_to_world = *draw_list[command.begin].local_to_world;
+
+			//compute modelview+projection (object space to clip space) matrix for this object:
+			command.object_to_clip = world_to_clip * local_to_world;
+
+			//(skips the inverse when scale is uniform)
+			command.normal_to_light = make_normal_matrix(local_to_world);
+
+			if (command.block_offset != -1U) {
+				ObjectBlock block;
+				block.object_to_clip = command.object_to_clip;
+				block.object_to_light = local_to_world;
+				block.normal_to_light = glm::mat4(command.normal_to_light);
+				std::memcpy(&view.uniform_data[command.block_offset], &block, sizeof(ObjectBlock));
+			}
+		}
+	});
+}
+
+void Scene::snapshot(Scene::Camera const *camera) {
+	assert(camera && "Must have a camera to draw scene from.");
+
+	if (transform_storage == TransformStorageFlat) {
+		update_transforms();
+	}
+
+	//copy objects, keeping level-of-detail choices made while drawing the last snapshot
+	// (copies line up with the last snapshot's unless objects were created or deleted):
+	// (only the Drawable part is copied; levels of detail go into one shared array, so nothing here allocates once capacity is reached)
+	uint32_t count = 0;
+	frozen.lods.clear();
+	frozen.lods_begin.clear();
+	for (Scene::Object *object = first_object; object != nullptr; object = object->alloc_next, ++count) {
+		if (count < frozen.objects.size()) {
+			uint32_t lod = (frozen.sources[count] == object ? frozen.objects[count].lod : object->lod);
+			frozen.objects[count] = *object;
+			frozen.objects[count].lod = lod;
+			frozen.sources[count] = object;
+			frozen.local_to_world[count] = this->local_to_world(object->transform);
+		} else {
+			frozen.objects.emplace_back(*object);
+			frozen.sources.emplace_back(object);
+			frozen.local_to_world.emplace_back(this->local_to_world(object->transform));
+		}
+		frozen.lods_begin.emplace_back(uint32_t(frozen.lods.size()));
+		frozen.lods.insert(frozen.lods.end(), object->lods.begin(), object->lods.end());
+	}
+	frozen.lods_begin.emplace_back(uint32_t(frozen.lods.size()));
+	frozen.objects.resize(count);
+	frozen.sources.resize(count);
+	frozen.local_to_world.resize(count);
+
+	frozen.occluder_to_world.clear();
+	for (auto const &occluder : occluders) {
+		frozen.occluder_to_world.emplace_back(this->local_to_world(occluder.transform));
+	}
+
+	frozen.world_to_camera = world_to_local(camera->transform);
+	frozen.fovy = camera->fovy;
+	frozen.near = camera->near;
+	frozen.frame_block = frame_block;
+	frozen.valid = true;
+}
+
+void Scene::draw_snapshot(float aspect) {
+	if (!frozen.valid) return;
+	prepare_snapshot(aspect);
+	submit();
+}
+
+void Scene::prepare_snapshot(float aspect) {
+	assert(frozen.valid && "Must take a snapshot before drawing it.");
+
+	views.resize(1);
+	View &view = views[0];
+	view.viewport = glm::ivec4(0);
+	view.draw_list.clear();
+	for (uint32_t i = 0; i < frozen.objects.size(); ++i) {
+		Drawable *object = &frozen.objects[i];
+		uint32_t lods = frozen.lods_begin[i];
+		view.draw_list.emplace_back(DrawItem{object, &frozen.local_to_world[i], frozen.lods.data() + lods, frozen.lods_begin[i+1] - lods, 0.0f, 0, object->start, object->count});
+	}
+
+	fetch_uniform_alignment();
+
+	//(same projection as Camera::make_projection)
+	glm::mat4 projection = glm::infinitePerspective(frozen.fovy, aspect, frozen.near);
+	prepare_draw_list(view, frozen.world_to_camera, projection, frozen.fovy, frozen.near, frozen.frame_block, frozen.occluder_to_world, false, worker_threads);
+
+	for (auto const &item : view.draw_list) {
+		item.object->lod = item.lod;
+	}
+}
+
+void Scene::fetch_uniform_alignment() {
+	if (uniform_stream.alignment == 0) {
+		uniform_stream.alignment = RenderDevice::current->uniform_buffer_offset_alignment();
+		uniform_stream.alignment = std::max(uniform_stream.alignment, 1);
 	}
 }
 
+void Scene::submit() {
+	RenderDevice &device = *RenderDevice::current;
+
+	//views with their own viewports change it, so remember the caller's:
+	GLint restore_viewport[4] = {0, 0, 0, 0};
+	bool viewports = false;
+	for (auto const &view : views) {
+		if (view.viewport != glm::ivec4(0)) viewports = true;
+	}
+	if (viewports) device.get_viewport(restore_viewport);
+
+	for (uint32_t v = 0; v < views.size(); ++v) {
+		View const &view = views[v];
+		if (view.viewport != glm::ivec4(0)) {
+			device.viewport(view.viewport.x, view.viewport.y, view.viewport.z, view.viewport.w);
+			if (v > 0) {
+				//clear just this view's rectangle, so it draws as an inset over earlier views:
+				device.scissor(view.viewport.x, view.viewport.y, view.viewport.z, view.viewport.w);
+				device.enable(GL_SCISSOR_TEST);
+				device.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				device.disable(GL_SCISSOR_TEST);
+			}
+		}
+		submit_view(view);
+	}
+
+	if (viewports) device.viewport(restore_viewport[0], restore_viewport[1], restore_viewport[2], restore_viewport[3]);
+}
+
+void Scene::submit_view(View const &view) {
+	RenderDevice &device = *RenderDevice::current;
+	std::vector< DrawItem > const &draw_list = view.draw_list;
+
+	//upload this view's uniform data into fresh storage (orphaning whatever earlier views wrote):
+	if (uniform_stream.buffer == 0) {
+		uniform_stream.buffer = device.create_buffer();
+	}
+	GLuint uniform_buffer = uniform_stream.buffer;
+	device.bind_buffer(GL_UNIFORM_BUFFER, uniform_buffer);
+	device.buffer_data(GL_UNIFORM_BUFFER, GLsizeiptr(view.uniform_data.size()), view.uniform_data.data(), GL_STREAM_DRAW);
+	device.bind_buffer(GL_UNIFORM_BUFFER, 0);
+
+	device.bind_buffer_range(GL_UNIFORM_BUFFER, FrameBlockBinding, uniform_buffer, 0, sizeof(FrameBlock));
+
+	//submit, skipping redundant binds:
+	GLuint bound_program = -1U;
+	GLuint bound_vao = -1U;
+	uint32_t bound_material = 0;
+	auto bind = [&](GLuint program, GLuint vao) {
+		if (program != bound_program) {
+			device.use_program(program);
+			bound_program = program;
+			bound_material = 0; //material uniforms are per-program
+		}
+		if (vao != bound_vao) {
+			device.bind_vertex_array(vao);
+			bound_vao = vao;
+		}
+	};
+
+	for (auto const &command : view.draw_commands) {
+		DrawItem const &item = draw_list[command.begin];
+		Scene::Drawable const *object = item.object;
+
+		if (command.instanced) {
+			//stream the run's instance records and draw it all at once:
+			GLsizei count = GLsizei(command.end - command.begin);
+			device.bind_buffer(GL_ARRAY_BUFFER, instance_buffer());
+			device.buffer_data(GL_ARRAY_BUFFER, count * sizeof(Instance), &view.instances[command.begin], GL_STREAM_DRAW);
+			device.bind_buffer(GL_ARRAY_BUFFER, 0);
+
+			bind(object->instanced_program, object->instanced_vao);
+			device.draw_arrays_instanced(GL_TRIANGLES, item.start, item.count, count);
+			continue;
+		}
+
+		bind(object->program, object->vao);
+
+		if (command.block_offset != -1U) {
+			device.bind_buffer_range(GL_UNIFORM_BUFFER, ObjectBlockBinding, uniform_buffer, command.block_offset, sizeof(ObjectBlock));
+		} else {
+			//set up program uniforms:
+			if (object->program_mvp_mat4 != -1U) {
+				device.uniform(object->program_mvp_mat4, command.object_to_clip);
+			}
+			if (object->program_mv_mat4x3 != -1U) {
+				device.uniform(object->program_mv_mat4x3, glm::mat4x3(*item.local_to_world));
+			}
+			if (object->program_itmv_mat3 != -1U) {
+				device.uniform(object->program_itmv_mat3, command.normal_to_light);
+			}
+		}
+
+		if (object->material != bound_material) {
+			Material const &material = materials[object->material];
+			for (uint32_t u = material.begin; u < material.end; ++u) {
+				MaterialUniform const &uniform = material_uniforms[u];
+				float const *value = &material_values[uniform.value];
+				if (uniform.type == MaterialUniform::Float) {
+					device.uniform(uniform.location, *value);
+				} else if (uniform.type == MaterialUniform::Vec3) {
+					device.uniform(uniform.location, glm::make_vec3(value));
+				} else if (uniform.type == MaterialUniform::Vec4) {
+					device.uniform(uniform.location, glm::make_vec4(value));
+				} else if (uniform.type == MaterialUniform::Mat4) {
+					device.uniform(uniform.location, glm::make_mat4(value));
+				}
+			}
+			bound_material = object->material;
+		}
+
+		//draw the object:
+		device.draw_arrays(GL_TRIANGLES, item.start, item.count);
+	}
+}
 
 Scene::~Scene() {
-	while (first_camera) {
-		delete_camera(first_camera);
+	//Everything is about to go away together, so skip the per-node unlinking that delete_*() does:
+	// run destructors, then let the pools release their chunks.
+	for (Camera *camera = first_camera; camera != nullptr; ) {
+		Camera *next = camera->alloc_next;
+		camera->~Camera();
+		camera = next;
+	}
+	for (Lamp *lamp = first_lamp; lamp != nullptr; ) {
+		Lamp *next = lamp->alloc_next;
+		lamp->~Lamp();
+		lamp = next;
 	}
-	while (first_object) {
-		delete_object(first_object);
+	for (Object *object = first_object; object != nullptr; ) {
+		Object *next = object->alloc_next;
+		object->~Object();
+		object = next;
 	}
-	while (first_transform) {
-		delete_transform(first_transform);
+	for (Transform *transform = first_transform; transform != nullptr; ) {
+		Transform *next = transform->alloc_next;
+		//(hierarchy only links transforms within this scene, so there is nothing to detach from)
+		transform->parent = transform->last_child = transform->prev_sibling = transform->next_sibling = nullptr;
+		transform->~Transform();
+		transform = next;
+	}
+	first_camera = nullptr;
+	first_lamp = nullptr;
+	first_object = nullptr;
+	first_transform = nullptr;
+
+	for (GLuint vao : static_vaos) {
+		glDeleteVertexArrays(1, &vao);
+	}
+	for (auto const &buffer : static_buffers) {
+		glDeleteBuffers(1, &buffer->vbo);
+	}
+
+	if (uniform_stream.buffer != 0) {
+		RenderDevice::current->delete_buffer(uniform_stream.buffer);
 	}
 }
@@ -1,13 +1,23 @@
 #pragma once
 
 #include "GL.hpp"
+#include "MeshBuffer.hpp"
+#include "OcclusionBuffer.hpp"
+#include "name_id.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
 #include <vector>
+#include <string>
+#include <utility>
 #include <list>
+#include <unordered_map>
+#include <memory>
 #include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <new>
 
 //"Scene" manages a hierarchy of transformations with, potentially, attached information.
 struct Scene {
@@ -34,9 +44,28 @@ struct Scene {
 		//computed from the above:
 		glm::mat4 make_local_to_parent() const;
 		glm::mat4 make_parent_to_local() const;
+		//(these two read from 'cache', below, so only cost a matrix product when something changed)
 		glm::mat4 make_local_to_world() const;
 		glm::mat4 make_world_to_local() const;
 
+		//cached world matrices:
+		// the cache is rebuilt when position/rotation/scale no longer match the values it was built from,
+		// when set_parent() marks it dirty, or when an ancestor's cache was rebuilt (noticed through 'stamp').
+		// So changing a transform invalidates its whole subtree without walking it.
+		struct Cache {
+			bool dirty = true;
+			uint32_t stamp = 0; //incremented every time the matrices below are rebuilt
+			uint32_t parent_stamp = 0; //parent's stamp when the matrices below were built
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+			glm::mat4 local_to_world;
+			glm::mat4 world_to_local;
+		};
+		mutable Cache cache;
+		//bring 'cache' (and the caches of all ancestors) up to date:
+		void update_cache() const;
+
 		//constructor/destructor:
 		Transform() = default;
 		Transform(Transform &) = delete;
@@ -52,29 +81,94 @@ struct Scene {
 		//used by Scene to manage allocation:
 		Transform **alloc_prev_next = nullptr;
 		Transform *alloc_next = nullptr;
-	};
 
-	//"Object"s contain information needed to render meshes:
-	struct Object {
-		Transform *transform; //objects must be attached to transforms.
-		Object(Transform *transform_) : transform(transform_) {
-			assert(transform);
-		}
+		//used by Scene to find this transform in 'flat' storage:
+		uint32_t flat_index = -1U;
 
+		//name (0 if none; change with Scene::set_name):
+		NameID name = 0;
+	};
+
+	//"Drawable" is the part of an Object that drawing reads (snapshots copy just this part):
+	struct Drawable {
 		//program info:
 		GLuint program = 0;
 		GLuint program_mvp_mat4 = -1U; //uniform index for object-to-clip matrix (mat4)
 		GLuint program_mv_mat4x3 = -1U; //uniform index for model-to-lighting-space matrix (mat4x3)
 		GLuint program_itmv_mat3 = -1U; //uniform index for normal-to-lighting-space matrix (mat3)
+		bool uniform_blocks = false; //program reads matrices from the "Object" block instead (the uniform indices above are ignored)
 
 		//material info:
-		std::function< void() > set_uniforms; //will be called before rendering object, use to set material parameters (e.g. glossiness)
+		uint32_t material = 0; //index in Scene::materials of uniform values to set before drawing (e.g. glossiness); 0 for none
+
+		//instancing info (optional):
+		// objects with an instanced_program that share program, vao, start, and count
+		// are drawn together with one glDrawArraysInstanced call using instanced_program and instanced_vao.
+		// instanced_vao must read per-instance attributes from Scene::instance_buffer() (see Scene::instance_attribs()).
+		// (objects with a material are never instanced, since material uniform locations belong to 'program')
+		GLuint instanced_program = 0;
+		GLuint instanced_vao = 0;
 
 		//attribute info:
 		GLuint vao = 0;
 		GLuint start = 0;
 		GLuint count = 0;
 
+		//bounds of the vertices in [start, start+count), in object-local space; used for culling:
+		// (a negative bounds_radius means bounds are unknown, and the object is never culled)
+		glm::vec3 bounds_min = glm::vec3(0.0f);
+		glm::vec3 bounds_max = glm::vec3(0.0f);
+		glm::vec3 bounds_center = glm::vec3(0.0f);
+		float bounds_radius = -1.0f;
+
+		//a level of detail's range (see Object::lods):
+		struct LOD {
+			GLuint start = 0;
+			GLuint count = 0;
+		};
+		uint32_t lod = 0; //level the main view chose last frame (kept for hysteresis)
+	};
+
+	//"Object"s contain information needed to render meshes:
+	struct Object : Drawable {
+		Transform *transform; //objects must be attached to transforms.
+		Object(Transform *transform_) : transform(transform_) {
+			assert(transform);
+		}
+
+		//buffer that [start, start+count) comes from (optional; bake_static() needs it to read vertices):
+		MeshBuffer const *mesh_buffer = nullptr;
+
+		//levels of detail (optional): lods[0] is the full mesh, later entries are coarser.
+		// when present, prepare() picks a level (per view) from the object's projected size and draws it in place of start/count.
+		// (all levels share the bounds above)
+		std::vector< LOD > lods;
+
+		//helper that sets start, count, bounds, and levels of detail from a mesh:
+		void set_mesh(MeshBuffer::Mesh const &mesh) {
+			start = mesh.start;
+			count = mesh.count;
+			bounds_min = mesh.min;
+			bounds_max = mesh.max;
+			bounds_center = mesh.center;
+			bounds_radius = mesh.radius;
+			lods.clear();
+			lod = 0;
+			if (!mesh.lods.empty()) {
+				lods.emplace_back();
+				lods.back().start = mesh.start;
+				lods.back().count = mesh.count;
+				for (auto const &range : mesh.lods) {
+					lods.emplace_back();
+					lods.back().start = range.start;
+					lods.back().count = range.count;
+				}
+			}
+		}
+
+		//name (0 if none; change with Scene::set_name):
+		NameID name = 0;
+
 		//used by Scene to manage allocation:
 		Object **alloc_prev_next = nullptr;
 		Object *alloc_next = nullptr;
@@ -100,12 +194,36 @@ struct Scene {
 		Camera *alloc_next = nullptr;
 	};
 
+	//"Lamp"s describe lights placed in a scene (as exported by export-scene.py):
+	struct Lamp {
+		Transform *transform; //lamps must be attached to transforms.
+		Lamp(Transform *transform_) : transform(transform_) {
+			assert(transform);
+		}
+		//NOTE: spot and directional lamps shine along their -z axis
+
+		enum Type : char {
+			Point = 'p',
+			Hemisphere = 'h',
+			Spot = 's',
+			Directional = 'd',
+		} type = Point;
+		glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f);
+		float energy = 1.0f;
+		float distance = 0.0f; //falloff distance
+		float spot_fov = 0.0f; //cone angle (in radians; spot lamps only)
+
+		//used by Scene to manage allocation:
+		Lamp **alloc_prev_next = nullptr;
+		Lamp *alloc_next = nullptr;
+	};
+
 	//------ functions to create / destroy scene things -----
 	//NOTE: all scene objects are automatically freed when scene is deallocated
 
 	//Create a new transform:
 	Transform *new_transform();
-	//Delete an existing transform: (NOTE: it is an error to delete a transform with an attached Object or Camera)
+	//Delete an existing transform: (NOTE: it is an error to delete a transform with an attached Object, Camera, or Lamp)
 	void delete_transform(Transform *);
 
 	//Create a new object attached to a transform:
@@ -118,18 +236,414 @@ struct Scene {
 	//Delete a camera:
 	void delete_camera(Camera *);
 
+	//Create a new lamp attached to a transform:
+	Lamp *new_lamp(Transform *transform);
+	//Delete a lamp:
+	void delete_lamp(Lamp *);
+
 	//used to manage allocated objects:
 	Transform *first_transform = nullptr;
 	Object *first_object = nullptr;
 	Camera *first_camera = nullptr;
+	Lamp *first_lamp = nullptr;
 	//(you shouldn't be manipulating these pointers directly
 
+	//"Pool"s hand out storage for scene things from large chunks:
+	// freed slots go on a free list for reuse, and chunks are only released when the pool is destroyed.
+	// (the pool doesn't track which slots are live -- Scene uses the lists above for that)
+	template< typename T >
+	struct Pool {
+		Pool() = default;
+		Pool(Pool const &) = delete;
+		~Pool() {
+			for (Slot *chunk : chunks) {
+				::operator delete(chunk);
+			}
+		}
+
+		template< typename... Args >
+		T *create(Args&&... args) {
+			if (!free_slots) {
+				//grow by a chunk, doubling chunk sizes up to a limit:
+				uint32_t count = (chunks.empty() ? 64 : std::min(2 * last_chunk_count, 4096U));
+				Slot *chunk = static_cast< Slot * >(::operator new(sizeof(Slot) * count));
+				for (uint32_t i = 0; i < count; ++i) {
+					chunk[i].next_free = (i + 1 < count ? &chunk[i+1] : nullptr);
+				}
+				chunks.emplace_back(chunk);
+				last_chunk_count = count;
+				free_slots = chunk;
+			}
+			Slot *slot = free_slots;
+			free_slots = slot->next_free;
+			return new (&slot->storage) T(std::forward< Args >(args)...); //"perfect forwarding"
+		}
+
+		//run destructor and return slot to the free list:
+		void destroy(T *t) {
+			t->~T();
+			Slot *slot = reinterpret_cast< Slot * >(t);
+			slot->next_free = free_slots;
+			free_slots = slot;
+		}
+
+	private:
+		union Slot {
+			Slot *next_free;
+			typename std::aligned_storage< sizeof(T), alignof(T) >::type storage;
+		};
+		std::vector< Slot * > chunks;
+		uint32_t last_chunk_count = 0;
+		Slot *free_slots = nullptr;
+	};
+	Pool< Transform > transform_pool;
+	Pool< Object > object_pool;
+	Pool< Camera > camera_pool;
+	Pool< Lamp > lamp_pool;
+
+	//------ names ------
+	//Transforms and objects may be named (load() names transforms after their Blender objects and objects after their meshes).
+	//Names are interned: each distinct name is kept once, in 'names', under its name_id(),
+	// so finding things by name is a hash lookup (and literal names can be hashed at compile time).
+	struct Named {
+		std::string name;
+		std::vector< Transform * > transforms; //(in the order they were named)
+		std::vector< Object * > objects;
+	};
+	std::unordered_map< NameID, Named > names;
+
+	//add a name to the table (if it isn't there yet) and return its id:
+	// note: will throw if a different name already has the same id
+	NameID intern(char const *begin, char const *end);
+	NameID intern(std::string const &name) { return intern(name.data(), name.data() + name.size()); }
+	//the name with a given id ("" if it was never interned):
+	std::string const &name_string(NameID id) const;
+
+	//(re)name a transform or object; the name must have been interned (0 removes the name):
+	void set_name(Transform *transform, NameID id);
+	void set_name(Object *object, NameID id);
+
+	//look up by name: the first transform or object given a name (or nullptr), or all of them:
+	Transform *find_transform(NameID id) const;
+	Object *find_object(NameID id) const;
+	std::vector< Transform * > const &find_transforms(NameID id) const;
+	std::vector< Object * > const &find_objects(NameID id) const;
+
+	//------ loading -----
+	//Load a '.scene' file (as written by export-scene.py) into this scene:
+	// the file is memory-mapped and its transforms -- stored parents-first -- are built in one pass,
+	// then make_object is called for every mesh entry (in file order) with the (interned) mesh name to attach an object,
+	// and a camera or lamp is created for every camera or lamp entry.
+	// make_object may return nullptr to skip a mesh (the transform is still created).
+	// note: will throw if the file fails to read.
+	struct Handles {
+		//one entry per transform in the file, in file order (parents before children):
+		std::vector< Transform * > transforms;
+		std::vector< Object * > objects; //(nullptr where no object is attached)
+		std::vector< Camera * > cameras;
+		std::vector< Lamp * > lamps;
+
+		//(Blender) object name ids with the matching transform index, sorted by id:
+		std::vector< std::pair< NameID, uint32_t > > names;
+
+		//look up by name (return -1U or nullptr if not found):
+		uint32_t find(NameID name) const;
+		Transform *transform(NameID name) const;
+		Object *object(NameID name) const;
+		Camera *camera(NameID name) const;
+		Lamp *lamp(NameID name) const;
+	};
+	Handles load(std::string const &filename, std::function< Object *(Transform *, NameID mesh) > const &make_object);
+
+	//------ flat transform storage ------
+	//In TransformStorageFlat mode, Scene keeps a copy of the hierarchy in contiguous arrays,
+	// sorted depth-first so every parent comes before its children (and each subtree is contiguous).
+	//update_transforms() then refreshes every world matrix in one linear pass.
+	//Transform * handles work the same in either mode.
+	enum TransformStorage {
+		TransformStorageLinked, //world matrices are computed on demand, per transform (default)
+		TransformStorageFlat, //world matrices are computed in one pass over 'flat' (draw() calls update_transforms())
+	};
+	TransformStorage transform_storage = TransformStorageLinked;
+
+	struct {
+		std::vector< Transform * > transforms; //handles, in parent-before-child order
+		std::vector< uint32_t > parents; //index of parent in these arrays, or -1U for roots
+		std::vector< glm::vec3 > positions;
+		std::vector< glm::quat > rotations;
+		std::vector< glm::vec3 > scales;
+		std::vector< glm::mat4 > local_to_world;
+		std::vector< glm::mat4 > world_to_local;
+		std::vector< uint32_t > stamps; //Transform::Cache::stamp the matrices above were taken from
+		//scratch space for update_transforms(): indices that changed, and their freshly built local matrices
+		std::vector< uint32_t > dirty;
+		std::vector< glm::mat4 > dirty_local_to_parent;
+		std::vector< glm::mat4 > dirty_parent_to_local;
+		//world-space bounding spheres of all objects in each subtree (computed by prepare() for culling; shared by all views):
+		std::vector< glm::vec3 > subtree_centers;
+		std::vector< float > subtree_radii; //negative: subtree has no objects; infinite: subtree has unbounded objects
+		bool sorted = false; //cleared when transforms are created or deleted
+	} flat;
+
+	//gather transforms into 'flat' (re-sorting if the hierarchy changed) and bring all world matrices up to date:
+	void update_transforms();
+
+	//world matrices that read 'flat' when it is current (valid just after update_transforms() in flat mode):
+	glm::mat4 const &local_to_world(Transform const *transform) const;
+	glm::mat4 const &world_to_local(Transform const *transform) const;
+
+	//------ static batching ------
+	//Bake objects in the subtree under 'root' (or every object, if 'root' is null) into merged, pre-transformed geometry:
+	// objects that share a mesh buffer, program, and material become one new object (so one draw call),
+	// with their vertices transformed to world space and copied into a new buffer.
+	//If 'chunk_size' is positive, objects are also split by which chunk_size-wide grid cell holds their world bounds center,
+	// so each baked object stays small enough to be culled (by the frustum or by occluders) on its own.
+	//Baked objects are deleted. Objects that 'keep_dynamic' returns true for and objects without a mesh_buffer are left as they are.
+	//Transforms in the subtree should not move afterward, since baked geometry no longer follows them.
+	void bake_static(Transform *root, std::function< bool(Object const *) > const &keep_dynamic = nullptr, float chunk_size = 0.0f);
+
+	//buffers and vertex arrays made by bake_static() (freed with the scene):
+	std::vector< std::unique_ptr< MeshBuffer > > static_buffers;
+	std::vector< GLuint > static_vaos;
+
+	//------ occlusion culling ------
+	//When enabled, prepare() rasterizes occluders (in view) into a CPU depth buffer
+	// and drops objects whose bounds are entirely hidden behind them.
+	//Occluders are kept apart from objects so that they survive bake_static(); keep them to a few big, simple meshes.
+	struct Occluder {
+		Transform const *transform = nullptr; //(must outlive the occluder entry)
+		MeshBuffer const *mesh_buffer = nullptr; //triangles are read from mesh_buffer->vertex_data
+		GLuint start = 0;
+		GLuint count = 0;
+		glm::vec3 bounds_min = glm::vec3(0.0f);
+		glm::vec3 bounds_max = glm::vec3(0.0f);
+	};
+	std::vector< Occluder > occluders;
+
+	//add an occluder with an object's transform, mesh range, and bounds (object must have a mesh_buffer):
+	void add_occluder(Object const *object);
+
+	bool occlusion_culling = false; //(each View rasterizes into its own OcclusionBuffer)
+
+	//------ spatial index ------
+	//A bounding volume hierarchy over objects' world-space bounds, for neighbour queries.
+	//update_spatial_index() refits it to wherever objects have moved, and rebuilds it when objects
+	// were created or deleted (or when refitting has made it too loose); queries see the state as of the last update.
+	void update_spatial_index();
+
+	//append objects whose world bounds come within 'radius' of 'point' to 'out':
+	void query_radius(glm::vec3 const &point, float radius, std::vector< Object * > *out) const;
+	//append objects whose world bounds may touch the cone from 'apex' along (unit) 'direction' to 'out':
+	// (conservative -- bounds are tested as spheres -- so callers should still check candidates)
+	void query_cone(glm::vec3 const &apex, glm::vec3 const &direction, float half_angle, float range, std::vector< Object * > *out) const;
+	//(objects without bounds are returned by every query)
+
+	struct {
+		struct Node {
+			glm::vec3 min, max;
+			float radius; //of a sphere around the box's center that holds the spheres around every object's box below (for cone queries)
+			uint32_t first; //leaf: first index in 'objects'; interior: index of first child (the second follows it)
+			uint32_t count; //leaf: number of objects; interior: 0
+		};
+		std::vector< Node > nodes; //nodes[0] is the root; children come after their parents
+		std::vector< Object * > objects; //objects with bounds, in leaf order
+		std::vector< glm::vec3 > mins; //world bounds of 'objects'
+		std::vector< glm::vec3 > maxs;
+		std::vector< Object * > unbounded; //objects without bounds
+		float built_area = 0.0f; //total node surface area when last rebuilt
+		bool built = false; //cleared when objects are created or deleted
+	} spatial;
+
+	//------ materials ------
+	//A material is a set of uniform values (e.g. glossiness) for the program of each object that uses it.
+	//Values for all materials are kept in one contiguous table; objects refer to materials by index (Object::material),
+	// and submit() -- which draws objects sorted by material -- only sets a material's uniforms when the material changes.
+	struct MaterialUniform {
+		enum Type : uint8_t { Float, Vec3, Vec4, Mat4 } type;
+		GLint location;
+		uint32_t value; //index of first float in material_values
+	};
+	struct Material {
+		uint32_t begin = 0; //range in material_uniforms
+		uint32_t end = 0;
+	};
+	std::vector< Material > materials = std::vector< Material >(1); //materials[0] is 'no material'
+	std::vector< MaterialUniform > material_uniforms;
+	std::vector< float > material_values;
+
+	//make a new (empty) material and return its index:
+	uint32_t new_material();
+	//set a material's uniform: uniforms may only be added to the newest material, but values can be changed at any time:
+	void set_material_uniform(uint32_t material, GLint location, float value);
+	void set_material_uniform(uint32_t material, GLint location, glm::vec3 const &value);
+	void set_material_uniform(uint32_t material, GLint location, glm::vec4 const &value);
+	void set_material_uniform(uint32_t material, GLint location, glm::mat4 const &value);
+	//(returns where the uniform's value is stored, adding it if needed)
+	float *material_value(uint32_t material, GLint location, MaterialUniform::Type type);
+
 	//------ functions to traverse the scene ------
 
 	//Draw the scene from a given camera by computing appropriate matrices and sending all objects to OpenGL:
 	//"camera" must be non-null!
+	// (same as prepare(camera) followed by submit())
 	void draw(Camera const *camera);
 
+	//Draw the scene from several cameras, each into its own viewport (x, y, width, height; all zero: leave the viewport as is):
+	// transforms and subtree bounds are updated once for all views, then views are culled and laid out in parallel,
+	// and submitted in order. Views after the first clear color and depth inside their viewport first, so they can be insets.
+	// (camera aspects are not changed -- set them to match the viewports)
+	void draw(std::vector< Camera const * > const &cameras, std::vector< glm::ivec4 > const &viewports);
+
+	//CPU phase of draw(): updates transforms, culls, sorts, and computes every object's matrices
+	// into each view's draw_commands / instances / uniform_data, spreading per-object work over worker threads:
+	void prepare(Camera const *camera);
+	void prepare(std::vector< Camera const * > const &cameras, std::vector< glm::ivec4 > const &viewports);
+	//GL phase of draw(): uploads what prepare() computed and issues the draw calls, view by view:
+	void submit();
+
+	//threads used by prepare() (0: one per hardware thread) and the fewest objects worth handing to a thread:
+	// (with several views, views are prepared at the same time, and each gets a share of the threads)
+	uint32_t worker_threads = 0;
+	uint32_t objects_per_worker = 256;
+
+	//objects that pass culling, sorted by program, vao, material, mesh, then front-to-back:
+	struct DrawItem {
+		Drawable *object; //(non-const: prepare() stores the main view's level of detail in the object)
+		glm::mat4 const *local_to_world;
+		Drawable::LOD const *lods; //the object's levels of detail (lod_count of them)
+		uint32_t lod_count;
+		float depth; //camera-space distance to object's bounds center
+		uint32_t lod; //level of detail chosen for this view
+		GLuint start, count; //mesh range drawn for this view (object's range, or its chosen level's)
+	};
+
+	//what submit() issues: single objects, or runs of draw_list that are drawn with one instanced call:
+	struct DrawCommand {
+		uint32_t begin, end; //range in draw_list
+		bool instanced; //if so, matrices are in instances[begin,end)
+		uint32_t block_offset; //offset of the object's ObjectBlock in uniform_data (-1U if it uses uniforms)
+		glm::mat4 object_to_clip; //(non-instanced commands only)
+		glm::mat3 normal_to_light;
+	};
+
+	//per-instance record streamed to instanced programs:
+	struct Instance {
+		glm::mat4 object_to_clip;
+		glm::mat4x3 object_to_light;
+		glm::mat3 normal_to_light;
+	};
+	static_assert(sizeof(Instance) == 4 * (16 + 12 + 9), "Instance is packed.");
+
+	//everything prepare() computes for one camera, and submit() issues (rebuilt by prepare()):
+	struct View {
+		glm::ivec4 viewport = glm::ivec4(0); //(all zero: draw into the current viewport)
+		std::vector< DrawItem > draw_list;
+		std::vector< DrawCommand > draw_commands;
+		//per-instance records, aligned with draw_list (filled for instanced commands only):
+		std::vector< Instance > instances;
+		//frame block, then object blocks, staged for upload into the uniform stream:
+		std::vector< uint8_t > uniform_data;
+		//scratch space for culling:
+		std::vector< uint8_t > draw_visible;
+		std::vector< uint8_t > subtree_visibility; //frustum test results for flat.transforms' subtrees
+		OcclusionBuffer occlusion;
+	};
+	std::vector< View > views = std::vector< View >(1); //views[0] is the main view; prepare() resizes to one per camera
+
+	std::vector< glm::mat4 > occluder_matrices; //scratch space for occlusion culling (shared by views)
+
+	//------ instancing ------
+
+	//buffer that instanced vaos read Instance records from (shared by all scenes; created on first use):
+	static GLuint instance_buffer();
+	//attributes describing Instance records (ObjectToClip, ObjectToLight, NormalToLight), for MeshBuffer::make_vao_for_program:
+	static std::vector< MeshBuffer::InstanceAttrib > const &instance_attribs();
+
+	//runs of at least this many matching objects use the instanced path:
+	uint32_t min_instances = 2;
+
+	//------ uniform blocks ------
+	//Programs may read per-frame data from a "Frame" block and per-object matrices from an "Object" block.
+	//draw() writes the frame's data into one uniform buffer, then each object only costs a glBindBufferRange().
+	enum : GLuint {
+		FrameBlockBinding = 0,
+		ObjectBlockBinding = 1,
+	};
+
+	//std140 layout: vec3s are padded to vec4s
+	struct FrameBlock {
+		glm::mat4 world_to_clip = glm::mat4(1.0f); //set by draw()
+		glm::vec4 sun_direction = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		glm::vec4 sun_color = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+		glm::vec4 sky_direction = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+		glm::vec4 sky_color = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	};
+	static_assert(sizeof(FrameBlock) == 4 * (16 + 4 * 4), "FrameBlock matches std140 layout.");
+	FrameBlock frame_block; //fill in lighting before draw()
+
+	//std140 layout: mat4x3 and mat3 columns are padded to vec4s, so all three are stored as mat4s
+	struct ObjectBlock {
+		glm::mat4 object_to_clip;
+		glm::mat4 object_to_light;
+		glm::mat4 normal_to_light;
+	};
+	static_assert(sizeof(ObjectBlock) == 4 * (3 * 16), "ObjectBlock matches std140 layout.");
+
+	//every view's uniform data goes through one buffer, orphaned (with buffer_data) before each upload,
+	// so data the GPU may still be reading from an earlier view or frame is never overwritten:
+	struct {
+		GLuint buffer = 0;
+		GLint alignment = 0; //GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT (fetched on first use)
+	} uniform_stream;
+
+	//skip objects whose bounds are outside the camera's view frustum:
+	// (with flat transform storage, whole subtrees are rejected at once using their combined bounds)
+	bool frustum_culling = true;
+
+	//level of detail selection (for objects with Object::lods):
+	// an object whose bounding sphere spans 'lod_screen_size' of the viewport height (or more) draws level 0,
+	// and each halving of that size moves one level coarser.
+	// a level only changes once the size is 'lod_hysteresis' (relative) past the boundary, so objects don't flicker between levels.
+	float lod_screen_size = 0.25f;
+	float lod_hysteresis = 0.1f;
+
+	//------ snapshots ------
+	//So that one thread can update the scene while another draws it:
+	// snapshot(camera) copies everything drawing reads -- each object's Drawable part and levels of detail, their world matrices, occluders' world matrices,
+	// the camera, and frame_block -- and draw_snapshot() draws that copy without touching any live Transform, Object, or Camera.
+	// After snapshot() returns, transforms, objects, cameras, and frame_block may be changed freely while draw_snapshot() runs
+	// (but not the occluder list, materials, or the drawing settings, and not snapshot() again).
+	// (snapshot draws have a single view, and don't use hierarchical culling, since that reads the live hierarchy)
+	void snapshot(Camera const *camera);
+	//'aspect' replaces the camera's, since the window may have been resized after the snapshot:
+	void draw_snapshot(float aspect);
+	void prepare_snapshot(float aspect);
+
+	struct Snapshot {
+		bool valid = false;
+		std::vector< Drawable > objects; //copies of what drawing reads from each object, made by snapshot()
+		std::vector< Object const * > sources; //the objects they were copied from (compared, never dereferenced)
+		std::vector< glm::mat4 > local_to_world; //(lines up with objects)
+		std::vector< Drawable::LOD > lods; //every object's levels of detail, back to back
+		std::vector< uint32_t > lods_begin; //where each object's levels start in 'lods' (lines up with objects, plus one past the end)
+		std::vector< glm::mat4 > occluder_to_world; //(lines up with occluders)
+		glm::mat4 world_to_camera = glm::mat4(1.0f);
+		float fovy = 0.0f;
+		float near = 0.0f;
+		FrameBlock frame_block;
+	} frozen;
+
+	//shared by prepare() and prepare_snapshot(): culls, picks levels of detail, sorts, and lays out a view's (already gathered) draw_list,
+	// using up to 'threads' worker threads. 'hierarchical' classifies flat.transforms' subtrees first, using the bounds prepare() gathers.
+	void prepare_draw_list(View &view, glm::mat4 const &world_to_camera, glm::mat4 const &projection, float fovy, float near,
+		FrameBlock const &frame, std::vector< glm::mat4 > const &occluder_to_world, bool hierarchical, uint32_t threads);
+	//uploads one view's uniform data and issues its draw calls (submit() does this for each view):
+	void submit_view(View const &view);
+	//gets uniform_stream.alignment from the device, if not yet known (must happen before views are prepared in parallel):
+	void fetch_uniform_alignment();
+
 
-	~Scene(); //destructor deallocates transforms, objects, cameras
+	Scene() = default;
+	Scene(Scene const &) = delete;
+	~Scene(); //destructor deallocates transforms, objects, cameras, lamps (in bulk, by releasing the pools) and uniform buffers
 };
@@ -1,21 +1,175 @@
 #include "WalkMesh.hpp"
 #include "MeshBuffer.hpp"
 #include "read_chunk.hpp"
+#include "parallel_for.hpp"
 
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
 
+#include <glm/gtc/quaternion.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define WALK_MESH_SSE
+#include <xmmintrin.h>
+#endif
+
 #define VERTEX_OFFSET 0.001f
 
-static glm::vec3 closest_point_on_triangle(glm::vec3 x, glm::vec3 y, glm::vec3 z, glm::vec3 p);
-static glm::vec3 world_to_barycentric(glm::vec3 x, glm::vec3 y, glm::vec3 z, glm::vec3 p);
-static glm::vec3 barycentric_to_world(glm::vec3 x, glm::vec3 y, glm::vec3 z, glm::vec3 p);
+namespace {
+
+//four floats, one per triangle in a TriangleGroup (same idea as in transform_kernels.cpp):
+struct Lanes {
+#ifdef WALK_MESH_SSE
+	__m128 v;
+#else
+	float v[4];
+#endif
+};
+//per-lane comparison results:
+struct Mask {
+#ifdef WALK_MESH_SSE
+	__m128 v;
+#else
+	bool v[4];
+#endif
+};
+
+#ifdef WALK_MESH_SSE
+inline Lanes load(float const f[4]) { return Lanes{_mm_loadu_ps(f)}; }
+inline void store(Lanes a, float f[4]) { _mm_storeu_ps(f, a.v); }
+inline Lanes splat(float f) { return Lanes{_mm_set1_ps(f)}; }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{_mm_add_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return Lanes{_mm_sub_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{_mm_mul_ps(a.v, b.v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return Lanes{_mm_div_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a) { return Lanes{_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))}; } //(flips the sign, as scalar negation does)
+inline Lanes clamp01(Lanes a) { return Lanes{_mm_min_ps(_mm_max_ps(a.v, _mm_setzero_ps()), _mm_set1_ps(1.0f))}; }
+inline Mask operator<(Lanes a, Lanes b) { return Mask{_mm_cmplt_ps(a.v, b.v)}; }
+inline Mask operator<=(Lanes a, Lanes b) { return Mask{_mm_cmple_ps(a.v, b.v)}; }
+inline Mask operator!=(Lanes a, Lanes b) { return Mask{_mm_cmpneq_ps(a.v, b.v)}; }
+inline Mask operator&(Mask a, Mask b) { return Mask{_mm_and_ps(a.v, b.v)}; }
+//bit l is set if lane l of 'mask' is:
+inline uint32_t bits(Mask mask) { return uint32_t(_mm_movemask_ps(mask.v)); }
+//lanes of 'a' where 'mask' is set, otherwise lanes of 'b':
+inline Lanes select(Mask mask, Lanes a, Lanes b) { return Lanes{_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))}; }
+#else
+inline Lanes load(float const f[4]) { return Lanes{{f[0], f[1], f[2], f[3]}}; }
+inline void store(Lanes a, float f[4]) { for (uint32_t l = 0; l < 4; ++l) f[l] = a.v[l]; }
+inline Lanes splat(float f) { return Lanes{{f, f, f, f}}; }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{{a.v[0]+b.v[0], a.v[1]+b.v[1], a.v[2]+b.v[2], a.v[3]+b.v[3]}}; }
+inline Lanes operator-(Lanes a, Lanes b) { return Lanes{{a.v[0]-b.v[0], a.v[1]-b.v[1], a.v[2]-b.v[2], a.v[3]-b.v[3]}}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{{a.v[0]*b.v[0], a.v[1]*b.v[1], a.v[2]*b.v[2], a.v[3]*b.v[3]}}; }
+inline Lanes operator/(Lanes a, Lanes b) { return Lanes{{a.v[0]/b.v[0], a.v[1]/b.v[1], a.v[2]/b.v[2], a.v[3]/b.v[3]}}; }
+inline Lanes operator-(Lanes a) { return Lanes{{-a.v[0], -a.v[1], -a.v[2], -a.v[3]}}; }
+inline Lanes clamp01(Lanes a) {
+	Lanes ret;
+	for (uint32_t l = 0; l < 4; ++l) ret.v[l] = std::min(std::max(a.v[l], 0.0f), 1.0f);
+	return ret;
+}
+inline Mask operator<(Lanes a, Lanes b) { return Mask{{a.v[0] < b.v[0], a.v[1] < b.v[1], a.v[2] < b.v[2], a.v[3] < b.v[3]}}; }
+inline Mask operator<=(Lanes a, Lanes b) { return Mask{{a.v[0] <= b.v[0], a.v[1] <= b.v[1], a.v[2] <= b.v[2], a.v[3] <= b.v[3]}}; }
+inline Mask operator!=(Lanes a, Lanes b) { return Mask{{a.v[0] != b.v[0], a.v[1] != b.v[1], a.v[2] != b.v[2], a.v[3] != b.v[3]}}; }
+inline Mask operator&(Mask a, Mask b) { return Mask{{a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2], a.v[3] && b.v[3]}}; }
+inline uint32_t bits(Mask mask) { return uint32_t(mask.v[0]) | uint32_t(mask.v[1]) << 1 | uint32_t(mask.v[2]) << 2 | uint32_t(mask.v[3]) << 3; }
+inline Lanes select(Mask mask, Lanes a, Lanes b) {
+	Lanes ret;
+	for (uint32_t l = 0; l < 4; ++l) ret.v[l] = (mask.v[l] ? a.v[l] : b.v[l]);
+	return ret;
+}
+#endif
+
+struct Lanes3 {
+	Lanes x, y, z;
+};
+inline Lanes3 load3(float const f[3][4]) { return Lanes3{load(f[0]), load(f[1]), load(f[2])}; }
+inline Lanes3 operator-(Lanes3 const &a, Lanes3 const &b) { return Lanes3{a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline Lanes dot(Lanes3 const &a, Lanes3 const &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+//one component of four vec3s:
+inline Lanes gather(glm::vec3 const *v[4], uint32_t c) {
+	float f[4] = {(*v[0])[c], (*v[1])[c], (*v[2])[c], (*v[3])[c]};
+	return load(f);
+}
+inline Lanes3 gather3(glm::vec3 const *v[4]) { return Lanes3{gather(v, 0), gather(v, 1), gather(v, 2)}; }
+
+//closest points to 'p' on a group's four triangles, as (v, w) along edge0 and edge1, and their squared distances:
+// the closest point is the projection of p into the plane when that lies inside the triangle, and otherwise the closest point on an edge,
+// so all four candidates are computed and the best one kept (no branches, so lanes stay in step).
+void closest_in_group(WalkMesh::TriangleGroup const &group, glm::vec3 const &p, float v_out[4], float w_out[4], float dist2_out[4]) {
+	Lanes3 edge0 = load3(group.edge0);
+	Lanes3 edge1 = load3(group.edge1);
+	Lanes3 q = Lanes3{splat(p.x), splat(p.y), splat(p.z)} - load3(group.origin);
+
+	//squared distance from p to origin + v * edge0 + w * edge1:
+	auto dist2 = [&](Lanes v, Lanes w) {
+		Lanes3 d{
+			q.x - v * edge0.x - w * edge1.x,
+			q.y - v * edge0.y - w * edge1.y,
+			q.z - v * edge0.z - w * edge1.z
+		};
+		return dot(d, d);
+	};
+
+	Lanes zero = splat(0.0f);
+	Lanes one = splat(1.0f);
+
+	//edge from first to second vertex:
+	Lanes v = clamp01(dot(q, edge0) * load(group.inv_length2[0]));
+	Lanes w = zero;
+	Lanes best = dist2(v, w);
+
+	//edge from first to third vertex:
+	Lanes t = clamp01(dot(q, edge1) * load(group.inv_length2[1]));
+	Lanes d = dist2(zero, t);
+	Mask closer = d < best;
+	v = select(closer, zero, v);
+	w = select(closer, t, w);
+	best = select(closer, d, best);
+
+	//edge from second to third vertex:
+	t = clamp01(dot(q - edge0, edge1 - edge0) * load(group.inv_length2[2]));
+	d = dist2(one - t, t);
+	closer = d < best;
+	v = select(closer, one - t, v);
+	w = select(closer, t, w);
+	best = select(closer, d, best);
+
+	//projection into the plane, if inside:
+	Lanes pv = dot(q, load3(group.to_v));
+	Lanes pw = dot(q, load3(group.to_w));
+	Mask inside = (zero <= pv) & (zero <= pw) & (pv + pw <= one);
+	d = dist2(pv, pw);
+	v = select(inside, pv, v);
+	w = select(inside, pw, w);
+	best = select(inside, d, best);
+
+	store(v, v_out);
+	store(w, w_out);
+	store(best, dist2_out);
+}
+
+}
+
+//cells of the hash grid used for welding (see WalkMesh::WalkMesh):
+namespace {
+struct WeldCell {
+	int32_t x, y, z;
+	bool operator==(WeldCell const &o) const { return x == o.x && y == o.y && z == o.z; }
+};
+struct WeldCellHash {
+	size_t operator()(WeldCell const &c) const {
+		return size_t((uint32_t(c.x) * 73856093U) ^ (uint32_t(c.y) * 19349663U) ^ (uint32_t(c.z) * 83492791U));
+	}
+};
+}
 
-WalkMesh::WalkMesh(std::string const &filename) {
+WalkMesh::WalkMesh(std::string const &filename, float weld_epsilon) {
 	std::ifstream file(filename, std::ios::binary);
 	struct Vertex {
 		glm::vec3 Position;
@@ -40,18 +194,66 @@ WalkMesh::WalkMesh(std::string const &filename) {
 
 	std::vector< uint32_t > ref_to_index(vertex_data.size(), -1);
 
+	//weld vertices by hashing them into a grid with 'weld_epsilon'-sized cells, so each vertex only checks nearby cells:
+	// (with weld_epsilon == 0, cells are exact positions; either way, a vertex welds to the first one close enough)
+	std::unordered_map< WeldCell, uint32_t, WeldCellHash > cell_first; //first welded vertex in each cell
+	std::vector< uint32_t > cell_next; //next welded vertex in the same cell (-1U: none)
+	auto cell_of = [weld_epsilon](glm::vec3 const &pos) {
+		WeldCell cell;
+		if (weld_epsilon > 0.0f) {
+			glm::vec3 c = glm::floor(pos / weld_epsilon);
+			cell.x = int32_t(c.x);
+			cell.y = int32_t(c.y);
+			cell.z = int32_t(c.z);
+		} else {
+			glm::vec3 exact = pos + glm::vec3(0.0f); //(so -0.0 and 0.0 share a cell)
+			std::memcpy(&cell, &exact, sizeof(cell));
+		}
+		return cell;
+	};
+	static_assert(sizeof(WeldCell) == sizeof(glm::vec3), "exact positions fit in a cell");
+	int32_t reach = (weld_epsilon > 0.0f ? 1 : 0); //neighbouring cells to check
+	float epsilon2 = weld_epsilon * weld_epsilon;
+
 	for (uint32_t i = 0; i < vertex_data.size(); ++i) {
 		Vertex data = vertex_data[i];
 		glm::vec3 pos = data.Position;
 		glm::vec3 norm = data.Normal;
 
-		auto find_result = std::find(vertices.begin(), vertices.end(), pos);
-		if (find_result == vertices.end()) {
+		WeldCell cell = cell_of(pos);
+		uint32_t found = -1U;
+		for (int32_t dz = -reach; dz <= reach; ++dz) {
+			for (int32_t dy = -reach; dy <= reach; ++dy) {
+				for (int32_t dx = -reach; dx <= reach; ++dx) {
+					auto f = cell_first.find(WeldCell{cell.x + dx, cell.y + dy, cell.z + dz});
+					if (f == cell_first.end()) continue;
+					for (uint32_t v = f->second; v != -1U; v = cell_next[v]) {
+						if (v >= found) break; //(chains are in index order, and the earliest match wins)
+						glm::vec3 d = vertices[v] - pos;
+						if (glm::dot(d, d) <= epsilon2) {
+							found = v;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if (found == -1U) {
 			ref_to_index[i] = vertices.size();
 			vertices.emplace_back(pos);
 			vertex_normals.emplace_back(norm);
+			//append to the cell's chain:
+			cell_next.emplace_back(-1U);
+			auto ret = cell_first.insert(std::make_pair(cell, ref_to_index[i]));
+			if (!ret.second) {
+				uint32_t v = ret.first->second;
+				while (cell_next[v] != -1U) v = cell_next[v];
+				cell_next[v] = ref_to_index[i];
+			}
 		} else {
-			ref_to_index[i] = find_result - vertices.begin();
+			ref_to_index[i] = found;
+			++welded;
 		}
 	}
 
@@ -67,33 +269,191 @@ WalkMesh::WalkMesh(std::string const &filename) {
             throw std::runtime_error("ref not mapped to index");
         }
 
-        next_vertex[glm::uvec2(a,b)] = c;
-        next_vertex[glm::uvec2(b,c)] = a;
-        next_vertex[glm::uvec2(c,a)] = b;
-
         triangles.emplace_back(glm::uvec3(a,b,c));
 	}
+
+	//precompute what walking needs from each triangle:
+	// (same formulas as https://gamedev.stackexchange.com/questions/23743/whats-the-most-efficient-way-to-find-barycentric-coordinates,
+	//  with the per-point dot products folded into to_v and to_w)
+	triangle_frames.reserve(triangles.size());
+	for (auto const &tri : triangles) {
+		TriangleFrame frame;
+		frame.origin = vertices[tri.x];
+		frame.edge0 = vertices[tri.y] - frame.origin;
+		frame.edge1 = vertices[tri.z] - frame.origin;
+		float a = glm::dot(frame.edge0, frame.edge0);
+		float b = glm::dot(frame.edge0, frame.edge1);
+		float c = glm::dot(frame.edge1, frame.edge1);
+		float inv_det = 1.0f / (a*c - b*b);
+		frame.to_v = (c * frame.edge0 - b * frame.edge1) * inv_det;
+		frame.to_w = (a * frame.edge1 - b * frame.edge0) * inv_det;
+		frame.normal = glm::normalize(glm::cross(frame.edge0, frame.edge1));
+		triangle_frames.emplace_back(frame);
+	}
+
+	//build the BVH, top-down, splitting the longest axis at the median (like Scene::update_spatial_index):
+	{
+		uint32_t const LeafSize = 4; //(one TriangleGroup)
+		std::vector< glm::vec3 > mins(triangles.size());
+		std::vector< glm::vec3 > maxs(triangles.size());
+		std::vector< uint32_t > order(triangles.size());
+		for (uint32_t t = 0; t < triangles.size(); ++t) {
+			glm::uvec3 const &tri = triangles[t];
+			mins[t] = glm::min(vertices[tri.x], glm::min(vertices[tri.y], vertices[tri.z]));
+			maxs[t] = glm::max(vertices[tri.x], glm::max(vertices[tri.y], vertices[tri.z]));
+			order[t] = t;
+		}
+
+		struct Range {
+			uint32_t node;
+			uint32_t begin, end; //in 'order'
+		};
+		std::vector< Range > todo;
+		if (!order.empty()) {
+			bvh.emplace_back();
+			todo.emplace_back(Range{0, 0, uint32_t(order.size())});
+		}
+		while (!todo.empty()) {
+			Range range = todo.back();
+			todo.pop_back();
+
+			glm::vec3 min = mins[order[range.begin]];
+			glm::vec3 max = maxs[order[range.begin]];
+			for (uint32_t i = range.begin + 1; i < range.end; ++i) {
+				min = glm::min(min, mins[order[i]]);
+				max = glm::max(max, maxs[order[i]]);
+			}
+			bvh[range.node].min = min;
+			bvh[range.node].max = max;
+
+			if (range.end - range.begin <= LeafSize) {
+				bvh[range.node].first = uint32_t(groups.size());
+				bvh[range.node].count = range.end - range.begin;
+				groups.emplace_back();
+				TriangleGroup &group = groups.back();
+				for (uint32_t l = 0; l < 4; ++l) {
+					uint32_t t = order[std::min(range.begin + l, range.end - 1)];
+					TriangleFrame const &frame = triangle_frames[t];
+					glm::vec3 edge2 = frame.edge1 - frame.edge0;
+					glm::vec3 length2 = glm::vec3(glm::dot(frame.edge0, frame.edge0), glm::dot(frame.edge1, frame.edge1), glm::dot(edge2, edge2));
+					for (uint32_t c = 0; c < 3; ++c) {
+						group.origin[c][l] = frame.origin[c];
+						group.edge0[c][l] = frame.edge0[c];
+						group.edge1[c][l] = frame.edge1[c];
+						group.to_v[c][l] = frame.to_v[c];
+						group.to_w[c][l] = frame.to_w[c];
+						group.inv_length2[c][l] = (length2[c] == 0.0f ? 0.0f : 1.0f / length2[c]);
+					}
+					group.triangles[l] = t;
+				}
+				continue;
+			}
+
+			glm::vec3 size = max - min;
+			uint32_t axis = (size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2));
+			uint32_t mid = (range.begin + range.end) / 2;
+			std::nth_element(order.begin() + range.begin, order.begin() + mid, order.begin() + range.end, [&](uint32_t a, uint32_t b) {
+				return mins[a][axis] + maxs[a][axis] < mins[b][axis] + maxs[b][axis];
+			});
+
+			uint32_t child = uint32_t(bvh.size());
+			bvh[range.node].first = child;
+			bvh[range.node].count = 0;
+			bvh.emplace_back();
+			bvh.emplace_back();
+			todo.emplace_back(Range{child, range.begin, mid});
+			todo.emplace_back(Range{child + 1, mid, range.end});
+		}
+	}
+
+	//find each triangle's neighbors by matching every edge with the same edge running the other way:
+	// (directed edge a->b maps to (triangle << 2 | corner opposite the edge); on non-manifold edges, the last triangle wins)
+	std::unordered_map< uint64_t, uint32_t > edge_owner;
+	edge_owner.reserve(3 * triangles.size());
+	auto edge_key = [](uint32_t a, uint32_t b) {
+		return (uint64_t(a) << 32) | uint64_t(b);
+	};
+	for (uint32_t t = 0; t < triangles.size(); ++t) {
+		glm::uvec3 const &tri = triangles[t];
+		for (uint32_t i = 0; i < 3; ++i) {
+			edge_owner[edge_key(tri[(i+1)%3], tri[(i+2)%3])] = (t << 2) | i;
+		}
+	}
+	neighbors.assign(triangles.size(), glm::uvec3(-1U));
+	for (uint32_t t = 0; t < triangles.size(); ++t) {
+		glm::uvec3 const &tri = triangles[t];
+		for (uint32_t i = 0; i < 3; ++i) {
+			auto f = edge_owner.find(edge_key(tri[(i+2)%3], tri[(i+1)%3]));
+			if (f != edge_owner.end()) neighbors[t][i] = f->second;
+		}
+	}
+
+	std::cout << "Walk mesh '" << filename << "' has " << vertices.size() << " vertices (" << welded << " welded) and "
+		<< triangles.size() << " triangles." << std::endl;
 }
 
 WalkPoint WalkMesh::start(glm::vec3 const &world_point) const {
 	WalkPoint walk_point;
-	float distance = FLT_MAX;
-
-	for (glm::uvec3 tri : triangles) {
-        //https://www.gamedev.net/forums/topic/552906-closest-point-on-triangle/
-        glm::vec3 x = vertices[tri.x];
-        glm::vec3 y = vertices[tri.y];
-        glm::vec3 z = vertices[tri.z];
-
-        glm::vec3 closest = closest_point_on_triangle(x, y, z, world_point);
-        float dist = glm::length(world_point - closest);
-        if (dist < distance) {
-            distance = dist;
-            walk_point.triangle = tri;
-            walk_point.weights = world_to_barycentric(x, y, z, closest);
-        }
-	}
-    return walk_point;
+	start(1, &world_point, &walk_point);
+	return walk_point;
+}
+
+void WalkMesh::start(uint32_t count, glm::vec3 const *world_points, WalkPoint *walk_points, uint32_t threads) const {
+	uint32_t const StackSize = 64;
+
+	parallel_for(count, threads, 64, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			glm::vec3 const &p = world_points[i];
+			WalkPoint &walk_point = walk_points[i];
+			walk_point = WalkPoint();
+			if (bvh.empty()) continue;
+
+			//squared distance from p to a node's box:
+			auto box_dist2 = [&p](BVHNode const &node) {
+				glm::vec3 d = p - glm::clamp(p, node.min, node.max);
+				return glm::dot(d, d);
+			};
+
+			//depth-first, nearer child first, skipping boxes farther than the best point so far:
+			// (ties go to the lowest triangle index, as a search over all triangles in order would pick;
+			//  triangle distances can round a little below the distance to their box, so boxes just past the best are still searched,
+			//  or a tied triangle with a lower index could be skipped)
+			float best = std::numeric_limits< float >::infinity();
+			uint32_t best_triangle = -1U;
+			float best_v = 0.0f, best_w = 0.0f;
+			uint32_t stack[StackSize];
+			uint32_t top = 0;
+			stack[top++] = 0;
+			while (top) {
+				BVHNode const &node = bvh[stack[--top]];
+				if (box_dist2(node) > best * (1.0f + 1e-4f) + 1e-8f) continue;
+				if (node.count) {
+					TriangleGroup const &group = groups[node.first];
+					float v[4], w[4], dist2[4];
+					closest_in_group(group, p, v, w, dist2);
+					for (uint32_t l = 0; l < node.count; ++l) {
+						if (dist2[l] < best || (dist2[l] == best && group.triangles[l] < best_triangle)) {
+							best = dist2[l];
+							best_triangle = group.triangles[l];
+							best_v = v[l];
+							best_w = w[l];
+						}
+					}
+				} else {
+					assert(top + 2 <= StackSize);
+					float near_dist2 = box_dist2(bvh[node.first]);
+					float far_dist2 = box_dist2(bvh[node.first + 1]);
+					uint32_t nearer = node.first, farther = node.first + 1;
+					if (far_dist2 < near_dist2) std::swap(nearer, farther);
+					stack[top++] = farther;
+					stack[top++] = nearer;
+				}
+			}
+
+			walk_point.triangle = best_triangle;
+			walk_point.weights = glm::vec3(1.0f - best_v - best_w, best_v, best_w);
+		}
+	});
 }
 
 void WalkMesh::walk(WalkPoint &wp, glm::vec3 const &step) const {
@@ -105,9 +465,8 @@ void WalkMesh::walk(WalkPoint &wp, glm::vec3 const &step) const {
 
         if (count > 5) break;
 
-        glm::vec3 x = vertices[wp.triangle.x];
-        glm::vec3 y = vertices[wp.triangle.y];
-        glm::vec3 z = vertices[wp.triangle.z];
+        glm::uvec3 const &tri = triangles[wp.triangle];
+        TriangleFrame const &frame = triangle_frames[wp.triangle];
 
         // Offset vertices to adjacent edge
         if (wp.weights.x == 1.0f) {
@@ -123,8 +482,11 @@ void WalkMesh::walk(WalkPoint &wp, glm::vec3 const &step) const {
             wp.weights.x += VERTEX_OFFSET;
         }
 
-        glm::vec3 bary_step_end = world_to_barycentric(x, y, z, world_point(wp) + current_step);
-        glm::vec3 bary_step = bary_step_end - wp.weights;
+        // (weights are linear in position, so the step's change in weights only depends on the step)
+        float step_v = glm::dot(current_step, frame.to_v);
+        float step_w = glm::dot(current_step, frame.to_w);
+        glm::vec3 bary_step = glm::vec3(-step_v - step_w, step_v, step_w);
+        glm::vec3 bary_step_end = wp.weights + bary_step;
 
         float tx = bary_step.x != 0.0f ? -wp.weights.x / bary_step.x : FLT_MAX;
         float ty = bary_step.y != 0.0f ? -wp.weights.y / bary_step.y : FLT_MAX;
@@ -160,47 +522,38 @@ void WalkMesh::walk(WalkPoint &wp, glm::vec3 const &step) const {
             wp.weights = bary_end;
         } else {
             // Find next triangle if against edge and still have distance to travel
-            std::vector< glm::uvec2 > valid_edges;
-            std::vector< glm::uvec2 > offset_index;
-            glm::uvec3 new_triangle = wp.triangle;
-            glm::uvec2 final_offset = glm::uvec2(0,0);
-
-            if (bary_end.x  <= 0.0f) {
-                valid_edges.emplace_back(glm::uvec2(wp.triangle.z, wp.triangle.y));
-                offset_index.emplace_back(glm::uvec2(2,1));
-            }
-            if (bary_end.y <= 0.0f) {
-                valid_edges.emplace_back(glm::uvec2(wp.triangle.x, wp.triangle.z));
-                offset_index.emplace_back(glm::uvec2(0,2));
-            }
-            if (bary_end.z <= 0.0f) {
-                valid_edges.emplace_back(glm::uvec2(wp.triangle.y, wp.triangle.x));
-                offset_index.emplace_back(glm::uvec2(1,0));
-            }
-
-            assert(valid_edges.size() <= 2);
-
-            for (uint32_t i = 0; i < valid_edges.size(); ++i) {
-                auto next_vert = next_vertex.find(valid_edges[i]);
-                if (next_vert != next_vertex.end()) {
-                    final_offset = offset_index[i];
-                    new_triangle = glm::uvec3(valid_edges[i].x, valid_edges[i].y, next_vert->second);
+            // (edges are numbered by the corner opposite them; the step ends on at most two)
+            uint32_t edges[3];
+            uint32_t edge_count = 0;
+            if (bary_end.x <= 0.0f) edges[edge_count++] = 0;
+            if (bary_end.y <= 0.0f) edges[edge_count++] = 1;
+            if (bary_end.z <= 0.0f) edges[edge_count++] = 2;
+
+            assert(edge_count <= 2);
+
+            uint32_t crossed = 0;
+            uint32_t next = -1U;
+            for (uint32_t i = 0; i < edge_count; ++i) {
+                next = neighbors[wp.triangle][edges[i]];
+                if (next != -1U) {
+                    crossed = edges[i];
                     break;
                 }
             }
 
-            if (new_triangle == wp.triangle) {
+            if (next == -1U) {
                 // Slide along edge components
 
-                if (bary_end.x >= 1.0f || bary_end.y >= 1.0f || bary_end.z >= 1.0f || !valid_edges.size()) {
+                if (bary_end.x >= 1.0f || bary_end.y >= 1.0f || bary_end.z >= 1.0f || edge_count == 0) {
                     wp.weights = bary_end;
                     break;
                 }
 
-                glm::vec3 v1 = vertices[*(&wp.triangle.x + offset_index[0].y)];
-                glm::vec3 v2 = vertices[*(&wp.triangle.x + offset_index[0].x)];
+                glm::vec3 v1 = vertices[tri[(edges[0] + 1) % 3]];
+                glm::vec3 v2 = vertices[tri[(edges[0] + 2) % 3]];
 
-                glm::vec3 new_step = barycentric_to_world(x, y, z, bary_step_end - bary_end);
+                glm::vec3 rest = bary_step_end - bary_end; //(weights of the rest of the step; they sum to zero)
+                glm::vec3 new_step = rest.y * frame.edge0 + rest.z * frame.edge1;
                 glm::vec3 from = glm::normalize(new_step);
                 glm::vec3 to = glm::normalize(v2 - v1);
                 float dot = glm::dot(from, to);
@@ -216,15 +569,17 @@ void WalkMesh::walk(WalkPoint &wp, glm::vec3 const &step) const {
                 current_step = glm::mat3_cast(rotate) * new_step;
 
             } else {
-                // Go to next triangle
+                // Go to next triangle (the shared edge runs the other way there)
+                uint32_t corner = next & 3;
                 glm::vec3 new_weights = glm::vec3(0.0f, 0.0f, 0.0f);
-                new_weights.x = *(&bary_end.x + final_offset.x);
-                new_weights.y = *(&bary_end.x + final_offset.y);
+                new_weights[(corner + 1) % 3] = bary_end[(crossed + 2) % 3];
+                new_weights[(corner + 2) % 3] = bary_end[(crossed + 1) % 3];
 
                 wp.weights = new_weights;
-                wp.triangle = new_triangle;
+                wp.triangle = next >> 2;
 
-                glm::vec3 new_step = barycentric_to_world(x, y, z, bary_step_end - bary_end);
+                glm::vec3 rest = bary_step_end - bary_end; //(weights of the rest of the step; they sum to zero)
+                glm::vec3 new_step = rest.y * frame.edge0 + rest.z * frame.edge1;
                 glm::vec3 from = glm::normalize(step);
                 glm::vec3 to = glm::normalize(new_step);
                 glm::vec3 axis = glm::normalize(glm::cross(from, to));
@@ -245,96 +600,60 @@ void WalkMesh::walk(WalkPoint &wp, glm::vec3 const &step) const {
     }
 }
 
-//Cdoe from https://www.gamedev.net/forums/topic/552906-closest-point-on-triangle/
-static glm::vec3 closest_point_on_triangle(glm::vec3 x, glm::vec3 y, glm::vec3 z, glm::vec3 p) {
-    glm::vec3 edge0 = y - x;
-    glm::vec3 edge1 = z - x;
-    glm::vec3 v0 = x - p;
-
-    float a = glm::dot(edge0, edge0);
-    float b = glm::dot(edge0, edge1);
-    float c = glm::dot(edge1, edge1);
-    float d = glm::dot(edge0, v0);
-    float e = glm::dot(edge1, v0 );
-
-    float det = a*c - b*b;
-    float s = b*e - c*d;
-    float t = b*d - a*e;
-
-    if ( s + t < det ) {
-        if ( s < 0.f ) {
-            if ( t < 0.f ) {
-                if ( d < 0.f ) {
-                    s = glm::clamp( -d/a, 0.f, 1.f );
-                    t = 0.f;
-                } else {
-                    s = 0.f;
-                    t = glm::clamp( -e/c, 0.f, 1.f );
-                }
-            } else {
-                s = 0.f;
-                t = glm::clamp( -e/c, 0.f, 1.f );
-            }
-        } else if ( t < 0.f ) {
-            s = glm::clamp( -d/a, 0.f, 1.f );
-            t = 0.f;
-        } else {
-            float invDet = 1.f / det;
-            s *= invDet;
-            t *= invDet;
-        }
-    } else {
-        if ( s < 0.f ) {
-            float tmp0 = b+d;
-            float tmp1 = c+e;
-            if ( tmp1 > tmp0 ) {
-                float numer = tmp1 - tmp0;
-                float denom = a-2*b+c;
-                s = glm::clamp( numer/denom, 0.f, 1.f );
-                t = 1-s;
-            } else {
-                t = glm::clamp( -e/c, 0.f, 1.f );
-                s = 0.f;
-            }
-        } else if ( t < 0.f ) {
-            if ( a+d > b+e ) {
-                float numer = c+e-b-d;
-                float denom = a-2*b+c;
-                s = glm::clamp( numer/denom, 0.f, 1.f );
-                t = 1-s;
-            } else {
-                s = glm::clamp( -e/c, 0.f, 1.f );
-                t = 0.f;
-            }
-        } else {
-            float numer = c+e-b-d;
-            float denom = a-2*b+c;
-            s = glm::clamp( numer/denom, 0.f, 1.f );
-            t = 1.f - s;
-        }
-    }
-    return x + s * edge0 + t * edge1;
-}
-
-//Code from https://gamedev.stackexchange.com/questions/23743/whats-the-most-efficient-way-to-find-barycentric-coordinates
-static glm::vec3 world_to_barycentric(glm::vec3 x, glm::vec3 y, glm::vec3 z, glm::vec3 p) {
-    glm::vec3 edge0 = y - x;
-    glm::vec3 edge1 = z - x;
-    glm::vec3 v0 = x - p;
-    float a = glm::dot(edge0, edge0);
-    float b = glm::dot(edge0, edge1);
-    float c = glm::dot(edge1, edge1);
-    float d = glm::dot(v0, edge0);
-    float e = glm::dot(v0, edge1);
-    float invDenom = 1.0 / (a*c - b*b);
-    float s = b*e - c*d;
-    float t = b*d - a*e;
-    float v = s * invDenom;
-    float w = t * invDenom;
-    float u = 1.0f - v - w;
-    return glm::vec3(u,v,w);
+void WalkMesh::walk(uint32_t count, WalkPoint *walk_points, glm::vec3 const *steps, uint32_t threads) const {
+	//agents are handled four at a time (leftovers padded out by repeating the last agent);
+	// the common case -- a step that ends inside the agent's triangle -- is done in lanes,
+	// by the same arithmetic as the first pass through walk()'s loop, and everything else goes through walk() itself:
+	parallel_for(count, threads, 256, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t b = begin; b < end; b += 4) {
+			WalkPoint *wp[4];
+			glm::vec3 const *weights[4];
+			glm::vec3 const *step[4];
+			glm::vec3 const *to_v[4];
+			glm::vec3 const *to_w[4];
+			for (uint32_t l = 0; l < 4; ++l) {
+				uint32_t i = std::min(b + l, end - 1);
+				wp[l] = &walk_points[i];
+				assert(wp[l]->triangle < triangles.size() && "walk points must be on the mesh (see start())");
+				weights[l] = &wp[l]->weights;
+				step[l] = &steps[i];
+				to_v[l] = &triangle_frames[wp[l]->triangle].to_v;
+				to_w[l] = &triangle_frames[wp[l]->triangle].to_w;
+			}
+			Lanes3 w = gather3(weights);
+			Lanes3 s = gather3(step);
+
+			Lanes step_v = dot(s, gather3(to_v));
+			Lanes step_w = dot(s, gather3(to_w));
+			Lanes3 bary_step{-step_v - step_w, step_v, step_w};
+
+			Lanes zero = splat(0.0f);
+			Lanes one = splat(1.0f);
+			Lanes never = splat(FLT_MAX);
+			//time at which each weight reaches zero (FLT_MAX if it doesn't), as walk() computes it:
+			auto edge_time = [&](Lanes weight, Lanes delta) {
+				Lanes t = select(delta != zero, -weight / delta, never);
+				return select(t <= zero, never, t);
+			};
+			//the whole step fits in the triangle when no edge is reached before its end:
+			Mask stays = (one <= edge_time(w.x, bary_step.x)) & (one <= edge_time(w.y, bary_step.y)) & (one <= edge_time(w.z, bary_step.z));
+			//(walk() nudges points sitting on a corner before stepping)
+			stays = stays & (w.x != one) & (w.y != one) & (w.z != one);
+			Lanes3 end_weights{w.x + bary_step.x, w.y + bary_step.y, w.z + bary_step.z};
+			stays = stays & (zero <= end_weights.x) & (zero <= end_weights.y) & (zero <= end_weights.z);
+
+			float x[4], y[4], z[4];
+			store(end_weights.x, x);
+			store(end_weights.y, y);
+			store(end_weights.z, z);
+			uint32_t fast = bits(stays);
+			for (uint32_t l = 0; l < 4 && b + l < end; ++l) {
+				if (fast & (1U << l)) {
+					wp[l]->weights = glm::vec3(x[l], y[l], z[l]);
+				} else {
+					walk(*wp[l], *step[l]);
+				}
+			}
+		}
+	});
 }
-
-static glm::vec3 barycentric_to_world(glm::vec3 x, glm::vec3 y, glm::vec3 z, glm::vec3 p) {
-    return p.x * x + p.y * y + p.z * z;
-}
\ No newline at end of file
@@ -4,48 +4,88 @@
 #include "MeshBuffer.hpp"
 
 #include <vector>
-#include <unordered_map>
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp> //allows the use of 'uvec2' as an unordered_map key
+#include <limits>
 
 struct WalkPoint {
-    glm::uvec3 triangle = glm::uvec3(-1U); //indices of current triangle
-    glm::vec3 weights = glm::vec3(std::numeric_limits< float >::quiet_NaN()); //barycentric coordinates for current point
+    uint32_t triangle = -1U; //index of current triangle (in WalkMesh::triangles)
+    glm::vec3 weights = glm::vec3(std::numeric_limits< float >::quiet_NaN()); //barycentric coordinates for current point (in the triangle's vertex order)
 };
 
 struct WalkMesh {
 
-	//Construct new WalkMesh and build next_vertex structure:
-	WalkMesh(std::string const &filename);
+	//Construct new WalkMesh and build neighbors structure:
+	// vertices closer than 'weld_epsilon' are welded into one (0 welds only identical positions)
+	WalkMesh(std::string const &filename, float weld_epsilon = 0.0f);
 
     //Walk mesh will keep track of triangles, vertices:
     std::vector< glm::vec3 > vertices;
     std::vector< glm::uvec3 > triangles; //CCW-oriented
     std::vector< glm::vec3 > vertex_normals;
-
-    //This "next vertex" map includes [a,b]->c, [b,c]->a, and [c,a]->b for each triangle, and is useful for checking what's over an edge from a given point:
-    std::unordered_map< glm::uvec2, uint32_t > next_vertex;
+    uint32_t welded = 0; //number of file vertices merged into others while loading
+
+    //Per-triangle data computed once at load, so that walking doesn't rebuild it at every step:
+    // a point p in the triangle's plane has barycentric weights (1 - v - w, v, w), with v = dot(p - origin, to_v) and w = dot(p - origin, to_w)
+    struct TriangleFrame {
+        glm::vec3 origin; //first vertex
+        glm::vec3 edge0, edge1; //first vertex to second and third
+        glm::vec3 to_v, to_w; //edge vectors combined and divided by their Gram determinant (see above)
+        glm::vec3 normal; //unit normal (CCW side)
+    };
+    std::vector< TriangleFrame > triangle_frames; //(lines up with triangles)
+
+    //What's over each edge of each triangle, for walking from one triangle to the next:
+    // neighbors[t][i] describes the triangle across the edge opposite corner i of triangles[t],
+    // as (index << 2 | corner of that triangle opposite the shared edge), or -1U if the edge is a boundary.
+    std::vector< glm::uvec3 > neighbors;
+
+    //Bounding volume hierarchy over triangles, for closest-point queries (built by the constructor):
+    // each leaf holds up to four triangles, packed into one TriangleGroup so they are tested together (with SSE when available).
+    struct BVHNode {
+        glm::vec3 min, max;
+        uint32_t first; //leaf: index in 'groups'; interior: index of first child (the second follows it)
+        uint32_t count; //leaf: number of triangles; interior: 0
+    };
+    std::vector< BVHNode > bvh; //bvh[0] is the root; children come after their parents
+
+    //four triangles' data, component by component ([x/y/z][lane]; unused lanes repeat the last triangle):
+    struct TriangleGroup {
+        float origin[3][4];
+        float edge0[3][4];
+        float edge1[3][4];
+        float to_v[3][4]; //(from triangle_frames)
+        float to_w[3][4];
+        float inv_length2[3][4]; //1 / squared length of edge0, edge1, and edge1 - edge0 (0 for zero-length edges)
+        uint32_t triangles[4];
+    };
+    std::vector< TriangleGroup > groups;
 
 	//used to initialize walking -- finds the closest point on the walk mesh:
-	// (should only need to call this at the start of a level)
+	// (searches the BVH, so it is cheap enough for respawns, teleports, and snapping many agents)
 	WalkPoint start(glm::vec3 const &world_point) const;
+	//closest points for 'count' world points at once, spread over up to 'threads' threads (0: one per hardware thread):
+	// (each point still searches the BVH on its own)
+	void start(uint32_t count, glm::vec3 const *world_points, WalkPoint *walk_points, uint32_t threads = 1) const;
 
 	//used to update walk point:
 	void walk(WalkPoint &wp, glm::vec3 const &step) const;
+	//walk many points at once (walk_points[i] takes steps[i]), with exactly the same results as walk(),
+	// spreading the points over up to 'threads' threads (0: one per hardware thread):
+	void walk(uint32_t count, WalkPoint *walk_points, glm::vec3 const *steps, uint32_t threads = 1) const;
 
 	//used to read back results of walking:
-	glm::vec3 world_point(WalkPoint &walk_point) const {
-		return walk_point.weights.x * vertices[walk_point.triangle.x]
-		     + walk_point.weights.y * vertices[walk_point.triangle.y]
-		     + walk_point.weights.z * vertices[walk_point.triangle.z];
+	glm::vec3 world_point(WalkPoint const &walk_point) const {
+		glm::uvec3 const &tri = triangles[walk_point.triangle];
+		return walk_point.weights.x * vertices[tri.x]
+		     + walk_point.weights.y * vertices[tri.y]
+		     + walk_point.weights.z * vertices[tri.z];
 	}
 
-	glm::vec3 world_normal(WalkPoint &walk_point) const {
+	glm::vec3 world_normal(WalkPoint const &walk_point) const {
+		glm::uvec3 const &tri = triangles[walk_point.triangle];
 		return glm::normalize(
-			vertex_normals[walk_point.triangle.x] * walk_point.weights.x +
-			vertex_normals[walk_point.triangle.y] * walk_point.weights.y +
-			vertex_normals[walk_point.triangle.z] * walk_point.weights.z);
+			vertex_normals[tri.x] * walk_point.weights.x +
+			vertex_normals[tri.y] * walk_point.weights.y +
+			vertex_normals[tri.z] * walk_point.weights.z);
 	}
 };
 
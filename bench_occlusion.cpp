@@ -0,0 +1,117 @@
+//Microbenchmark: OcclusionBuffer rasterization, pyramid build, and box tests, run headless.
+//Build with 'jam bench_occlusion'; run as 'bench/bench_occlusion [boxes] [repeats]'.
+//The scene is a wall in front of the camera with random boxes scattered around and behind it;
+// box tests are also checked against the exact answer, since the buffer must never hide a visible box.
+
+#include "OcclusionBuffer.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+
+//run 'fn' 'repeats' times, report the best time in microseconds:
+template< typename F >
+static double best_time(uint32_t repeats, F const &fn) {
+	double best = std::numeric_limits< double >::infinity();
+	for (uint32_t r = 0; r < repeats; ++r) {
+		auto before = std::chrono::high_resolution_clock::now();
+		fn();
+		auto after = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration< double, std::micro >(after - before).count());
+	}
+	return best;
+}
+
+int main(int argc, char **argv) {
+	uint32_t count = (argc > 1 ? uint32_t(std::atoi(argv[1])) : 10000);
+	uint32_t repeats = (argc > 2 ? uint32_t(std::atoi(argv[2])) : 20);
+
+	//camera at the origin looking down -z:
+	glm::mat4 world_to_clip = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+
+	//wall: a square at z = -Wall, half-size Half, split into many triangles (as a detailed occluder would be):
+	float const Wall = 5.0f;
+	float const Half = 2.0f;
+	uint32_t const Cells = 16;
+	std::vector< glm::vec3 > wall;
+	for (uint32_t y = 0; y < Cells; ++y) {
+		for (uint32_t x = 0; x < Cells; ++x) {
+			auto at = [&](uint32_t cx, uint32_t cy) {
+				return glm::vec3(-Half + 2.0f * Half * cx / Cells, -Half + 2.0f * Half * cy / Cells, -Wall);
+			};
+			wall.emplace_back(at(x, y)); wall.emplace_back(at(x+1, y)); wall.emplace_back(at(x+1, y+1));
+			wall.emplace_back(at(x, y)); wall.emplace_back(at(x+1, y+1)); wall.emplace_back(at(x, y+1));
+		}
+	}
+
+	//boxes in front of the camera, some in front of the wall and most behind:
+	std::mt19937 mt(0xfeedf00d);
+	std::uniform_real_distribution< float > unit(0.0f, 1.0f);
+	std::vector< glm::vec3 > mins(count), maxs(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		float z = -1.0f - 29.0f * unit(mt);
+		float spread = -z * 0.4f; //roughly inside the view
+		glm::vec3 center = glm::vec3(spread * (2.0f * unit(mt) - 1.0f), spread * (2.0f * unit(mt) - 1.0f), z);
+		glm::vec3 radius = glm::vec3(0.05f + 0.5f * unit(mt));
+		mins[i] = center - radius;
+		maxs[i] = center + radius;
+	}
+
+	//exact answer: every corner behind the wall, and projecting inside it:
+	auto hidden = [&](uint32_t i) {
+		for (uint32_t c = 0; c < 8; ++c) {
+			glm::vec3 p = glm::vec3(
+				(c & 1 ? maxs[i].x : mins[i].x),
+				(c & 2 ? maxs[i].y : mins[i].y),
+				(c & 4 ? maxs[i].z : mins[i].z)
+			);
+			if (p.z >= -Wall) return false;
+			glm::vec2 on_wall = glm::vec2(p) * (Wall / -p.z);
+			if (std::abs(on_wall.x) > Half || std::abs(on_wall.y) > Half) return false;
+		}
+		return true;
+	};
+
+	OcclusionBuffer buffer;
+	uint32_t vertex_count = uint32_t(wall.size());
+	uint8_t const *positions = reinterpret_cast< uint8_t const * >(wall.data());
+
+	double raster_us = best_time(repeats, [&](){
+		buffer.clear();
+		buffer.rasterize_triangles(world_to_clip, positions, sizeof(glm::vec3), vertex_count);
+	});
+	double pyramid_us = best_time(repeats, [&](){
+		buffer.build_pyramid();
+	});
+	std::vector< uint8_t > occluded(count);
+	double test_us = best_time(repeats, [&](){
+		for (uint32_t i = 0; i < count; ++i) {
+			occluded[i] = buffer.box_occluded(world_to_clip, mins[i], maxs[i]);
+		}
+	});
+
+	uint32_t culled = 0, exact = 0, wrong = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		bool h = hidden(i);
+		if (occluded[i]) ++culled;
+		if (h) ++exact;
+		if (occluded[i] && !h) ++wrong;
+	}
+
+	std::cout << "buffer " << buffer.levels[0].width << "x" << buffer.levels[0].height
+		<< ", " << vertex_count / 3 << " occluder triangles, " << count << " boxes, best of " << repeats << " runs\n";
+	std::cout << "  rasterize: " << raster_us << " us\n";
+	std::cout << "  pyramid: " << pyramid_us << " us\n";
+	std::cout << "  box tests: " << test_us << " us (" << 1000.0 * test_us / count << " ns per box)\n";
+	std::cout << "  occluded: " << culled << " of " << exact << " hidden boxes found; " << wrong << " visible boxes wrongly occluded\n";
+
+	return (wrong == 0 ? 0 : 1);
+}
@@ -0,0 +1,518 @@
+//Benchmark: Scene transform updates, draw-list preparation, and submission, run headless against null_gl.
+//Build with 'jam bench_scene'; run as 'bench/bench_scene [max_objects] [depth] [repeats] [options]'.
+//Synthetic scenes of 1k, 10k, ... objects (up to max_objects) are built as a grid of cubes under 'depth' levels of group transforms,
+// and viewed by a camera at one corner of the grid, so some objects are culled.
+//Options: 'linked' (TransformStorageLinked instead of flat), 'instanced' (objects can be instanced), 'serial' (one worker thread),
+// 'record' (submit through a RecordingRenderDevice, which passes calls on to null_gl; afterwards, two more identical frames
+//  are recorded with buffer contents and must match, and replaying one into another recorder must reproduce it),
+// 'views' (also draw an overhead view of the whole grid into an inset viewport, as a minimap would).
+//With 'crates', the level from dist/phone-bank.{pnc,scene} is set up the way CratesMode does it (platforms as occluders,
+// everything but the player and phones baked) and viewed from a few spots on the platforms, with and without
+// chunked baking and occlusion culling, to show how many draws the occluders remove. (Run from the repository root.)
+//With 'queries', objects scattered at random (a tenth of them moving each frame) are put in the spatial index,
+// and query_radius / query_cone results are checked against testing every object, with both timed.
+
+#include "Scene.hpp"
+#include "RenderDevice.hpp"
+#include "null_gl.hpp"
+#include "MeshBuffer.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <cassert>
+
+struct Options {
+	uint32_t depth = 2;
+	uint32_t repeats = 10;
+	bool linked = false;
+	bool instanced = false;
+	bool serial = false;
+	bool record = false;
+	bool views = false;
+	bool crates = false;
+	bool queries = false;
+};
+
+//per-frame times (best of the repeats, in nanoseconds) and what the frame drew:
+struct Result {
+	double moving_ns = std::numeric_limits< double >::infinity(); //update_transforms() after every root moved
+	double static_ns = std::numeric_limits< double >::infinity(); //update_transforms() when nothing moved
+	double prepare_ns = std::numeric_limits< double >::infinity();
+	double submit_ns = std::numeric_limits< double >::infinity();
+	uint32_t visible = 0; //(summed over views)
+	uint64_t draw_calls = 0;
+	uint64_t binds = 0; //program + vao + buffer
+	uint64_t upload_bytes = 0;
+	uint32_t commands = 0; //recorded (with 'record' only)
+	uint32_t frame_difference = -1U; //first command that differs between two identical frames (with 'record' only)
+	uint32_t replay_difference = -1U; //first command that differs between a frame and its replay (with 'record' only)
+};
+
+static double elapsed_ns(std::chrono::high_resolution_clock::time_point before) {
+	auto after = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration< double, std::nano >(after - before).count();
+}
+
+static Result run(uint32_t count, Options const &options) {
+	Scene scene;
+	scene.transform_storage = (options.linked ? Scene::TransformStorageLinked : Scene::TransformStorageFlat);
+	if (options.serial) scene.worker_threads = 1;
+
+	//objects on a grid in the xy plane, 'Spacing' apart:
+	float const Spacing = 2.0f;
+	uint32_t side = uint32_t(std::ceil(std::sqrt(double(count))));
+	auto grid = [&](uint32_t i) {
+		return glm::vec3(Spacing * float(i % side), Spacing * float(i / side), 0.0f);
+	};
+
+	//group transforms: the group at level l holding object i is number i / spans[l],
+	// with spans chosen so each group has about the same number of children:
+	uint32_t depth = options.depth;
+	uint32_t branch = std::max(2U, uint32_t(std::ceil(std::pow(double(count), 1.0 / double(depth + 1)))));
+	std::vector< uint32_t > spans(depth, 1);
+	for (uint32_t l = depth; l > 0; --l) {
+		spans[l-1] = (l == depth ? branch : spans[l] * branch);
+	}
+
+	std::vector< Scene::Transform * > roots;
+	std::vector< Scene::Transform * > path(depth, nullptr);
+	std::vector< uint32_t > path_index(depth, -1U);
+	std::vector< glm::vec3 > path_position(depth); //world position of each group on the path
+	for (uint32_t i = 0; i < count; ++i) {
+		for (uint32_t l = 0; l < depth; ++l) {
+			if (path_index[l] == i / spans[l]) continue;
+			path_index[l] = i / spans[l];
+			path[l] = scene.new_transform();
+			path_position[l] = grid(i);
+			if (l == 0) {
+				path[l]->position = path_position[l];
+				roots.emplace_back(path[l]);
+			} else {
+				path[l]->set_parent(path[l-1]);
+				path[l]->position = path_position[l] - path_position[l-1];
+			}
+		}
+
+		Scene::Transform *transform = scene.new_transform();
+		if (depth == 0) {
+			transform->position = grid(i);
+			roots.emplace_back(transform);
+		} else {
+			transform->set_parent(path[depth-1]);
+			transform->position = grid(i) - path_position[depth-1];
+		}
+		transform->scale = glm::vec3(0.5f);
+
+		//unit cubes, four different meshes (so draws don't all batch together):
+		Scene::Object *object = scene.new_object(transform);
+		object->program = 1;
+		object->vao = 1;
+		object->uniform_blocks = true;
+		object->start = 36 * (i % 4);
+		object->count = 36;
+		object->bounds_min = glm::vec3(-1.0f);
+		object->bounds_max = glm::vec3( 1.0f);
+		object->bounds_center = glm::vec3(0.0f);
+		object->bounds_radius = std::sqrt(3.0f);
+		if (options.instanced) {
+			object->instanced_program = 2;
+			object->instanced_vao = 2;
+		}
+	}
+
+	//camera above one corner of the grid, looking diagonally across it:
+	Scene::Camera *camera = scene.new_camera(scene.new_transform());
+	camera->transform->position = glm::vec3(-10.0f, -10.0f, 20.0f);
+	camera->transform->rotation =
+		glm::angleAxis(glm::radians(-45.0f), glm::vec3(0.0f, 0.0f, 1.0f))
+		* glm::angleAxis(glm::radians(60.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	camera->fovy = glm::radians(60.0f);
+	camera->aspect = 16.0f / 9.0f;
+
+	std::vector< Scene::Camera const * > cameras(1, camera);
+	std::vector< glm::ivec4 > viewports(1, glm::ivec4(0));
+	if (options.views) {
+		//looking straight down at the middle of the grid from high enough to see all of it:
+		Scene::Camera *overhead = scene.new_camera(scene.new_transform());
+		float middle = 0.5f * Spacing * float(side);
+		overhead->transform->position = glm::vec3(middle, middle, 2.0f * middle + 10.0f);
+		overhead->fovy = glm::radians(60.0f);
+		overhead->aspect = 1.0f;
+		cameras.emplace_back(overhead);
+		viewports.emplace_back(glm::ivec4(0, 0, 128, 128));
+	}
+
+	RecordingRenderDevice recorder;
+	recorder.forward = RenderDevice::current;
+	recorder.record_buffer_data = false;
+	RenderDevice *device = RenderDevice::current;
+	if (options.record) RenderDevice::current = &recorder;
+
+	Result result;
+	for (uint32_t r = 0; r < options.repeats; ++r) {
+		//move every root a little, so every world matrix must be rebuilt:
+		float angle = 0.001f * float(r + 1);
+		for (auto root : roots) {
+			root->rotation = glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f));
+		}
+
+		if (!options.linked) {
+			auto before = std::chrono::high_resolution_clock::now();
+			scene.update_transforms();
+			result.moving_ns = std::min(result.moving_ns, elapsed_ns(before));
+
+			before = std::chrono::high_resolution_clock::now();
+			scene.update_transforms();
+			result.static_ns = std::min(result.static_ns, elapsed_ns(before));
+		}
+
+		//(with linked storage, prepare() also pays for rebuilding the moved transforms' caches)
+		auto before = std::chrono::high_resolution_clock::now();
+		scene.prepare(cameras, viewports);
+		result.prepare_ns = std::min(result.prepare_ns, elapsed_ns(before));
+
+		recorder.reset();
+		NullGLCounts counts_before = null_gl_counts;
+		before = std::chrono::high_resolution_clock::now();
+		scene.submit();
+		result.submit_ns = std::min(result.submit_ns, elapsed_ns(before));
+
+		result.visible = 0;
+		for (auto const &view : scene.views) {
+			result.visible += uint32_t(view.draw_list.size());
+		}
+		result.draw_calls = null_gl_counts.draw_calls - counts_before.draw_calls;
+		result.binds = (null_gl_counts.program_binds - counts_before.program_binds)
+			+ (null_gl_counts.vao_binds - counts_before.vao_binds)
+			+ (null_gl_counts.buffer_binds - counts_before.buffer_binds);
+		result.upload_bytes = null_gl_counts.upload_bytes - counts_before.upload_bytes;
+		result.commands = uint32_t(recorder.commands.size());
+	}
+
+	if (options.record) {
+		//nothing moves, so two more frames should issue the same calls with the same data:
+		RecordingRenderDevice frames[2];
+		for (auto &frame : frames) {
+			frame.forward = device;
+			RenderDevice::current = &frame;
+			scene.prepare(cameras, viewports);
+			scene.submit();
+		}
+		result.frame_difference = frames[1].first_difference(frames[0]);
+
+		//replaying a frame should reproduce it:
+		RecordingRenderDevice replayed;
+		replayed.forward = device;
+		frames[0].replay(replayed);
+		result.replay_difference = replayed.first_difference(frames[0]);
+
+		//(a recording without buffer contents replays too, uploading nothing it didn't keep)
+		RecordingRenderDevice sizes_only;
+		recorder.replay(sizes_only);
+		assert(sizes_only.draw_calls() == recorder.draw_calls());
+	}
+
+	RenderDevice::current = device;
+	return result;
+}
+
+//draws left over the 'crates' level's camera spots, with the level baked in 'chunk_size' chunks (0 for none):
+struct CratesResult {
+	uint32_t baked = 0; //objects drawing baked geometry
+	uint32_t visible = 0; //(summed over spots)
+	double prepare_ns = std::numeric_limits< double >::infinity(); //(all spots)
+};
+
+static CratesResult run_crates(float chunk_size, bool occlusion_culling, Options const &options) {
+	static MeshBuffer meshes("dist/phone-bank.pnc");
+
+	Scene scene;
+	scene.transform_storage = Scene::TransformStorageFlat;
+	scene.occlusion_culling = occlusion_culling;
+	if (options.serial) scene.worker_threads = 1;
+
+	//same objects as CratesMode:
+	scene.load("dist/phone-bank.scene", [&](Scene::Transform *transform, NameID mesh) -> Scene::Object * {
+		if (mesh == name_id("Phone_Flash") || mesh == name_id("Phone_Interact")) {
+			return nullptr;
+		}
+		Scene::Object *object = scene.new_object(transform);
+		object->program = 1;
+		object->vao = 1;
+		object->uniform_blocks = true;
+		object->mesh_buffer = &meshes;
+		object->set_mesh(meshes.lookup(scene.name_string(mesh)));
+		if (mesh == name_id("Circle") || mesh == name_id("Plane")) {
+			scene.add_occluder(object);
+		}
+		return object;
+	});
+	scene.bake_static(nullptr, [](Scene::Object const *object) {
+		return object->name == name_id("Player") || object->name == name_id("Phone");
+	}, chunk_size);
+
+	CratesResult result;
+	for (Scene::Object const *object = scene.first_object; object != nullptr; object = object->alloc_next) {
+		if (object->mesh_buffer != &meshes) ++result.baked;
+	}
+
+	//standing (eye height above) each platform, looking around and a little down:
+	std::vector< Scene::Camera const * > cameras;
+	glm::vec3 const Spots[3] = {
+		glm::vec3(0.0f, 0.0f, 1.8f), //"Circle"
+		glm::vec3(4.0f, 0.0f, 1.8f), //"Plane"
+		glm::vec3(21.0f, -2.0f, 6.8f), //"Circle.002"
+	};
+	for (glm::vec3 const &spot : Spots) {
+		for (uint32_t a = 0; a < 8; ++a) {
+			Scene::Camera *camera = scene.new_camera(scene.new_transform());
+			camera->transform->position = spot;
+			camera->transform->rotation =
+				glm::angleAxis(glm::radians(45.0f * float(a)), glm::vec3(0.0f, 0.0f, 1.0f))
+				* glm::angleAxis(glm::radians(60.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+			camera->fovy = glm::radians(60.0f);
+			camera->aspect = 16.0f / 9.0f;
+			cameras.emplace_back(camera);
+		}
+	}
+
+	scene.update_transforms();
+	for (uint32_t r = 0; r < options.repeats; ++r) {
+		result.visible = 0;
+		double prepare_ns = 0.0;
+		for (Scene::Camera const *camera : cameras) {
+			auto before = std::chrono::high_resolution_clock::now();
+			scene.prepare(camera);
+			prepare_ns += elapsed_ns(before);
+			result.visible += uint32_t(scene.views[0].draw_list.size());
+		}
+		result.prepare_ns = std::min(result.prepare_ns, prepare_ns);
+	}
+	return result;
+}
+
+//spatial index queries against a scan of every object (times are per query, in nanoseconds):
+struct QueriesResult {
+	double update_ns = std::numeric_limits< double >::infinity(); //update_spatial_index() after some objects moved
+	double radius_ns = std::numeric_limits< double >::infinity();
+	double radius_scan_ns = std::numeric_limits< double >::infinity();
+	double cone_ns = std::numeric_limits< double >::infinity();
+	double cone_scan_ns = std::numeric_limits< double >::infinity();
+	uint64_t found = 0; //(radius + cone, summed over queries)
+	uint32_t mismatches = 0; //queries whose results differ from the scan
+};
+
+static QueriesResult run_queries(uint32_t count, Options const &options) {
+	Scene scene;
+	scene.transform_storage = (options.linked ? Scene::TransformStorageLinked : Scene::TransformStorageFlat);
+
+	//objects of varied size in a slab about as wide as the draw benchmark's grid:
+	std::mt19937 mt(0x5eed);
+	auto unit = [&mt]() {
+		return std::uniform_real_distribution< float >(0.0f, 1.0f)(mt);
+	};
+	float const Width = 2.0f * std::sqrt(float(count));
+	std::vector< Scene::Object * > objects;
+	for (uint32_t i = 0; i < count; ++i) {
+		Scene::Transform *transform = scene.new_transform();
+		transform->position = glm::vec3(Width * unit(), Width * unit(), 10.0f * unit());
+		transform->rotation = glm::angleAxis(6.28f * unit(), glm::normalize(glm::vec3(unit() - 0.5f, unit() - 0.5f, 1.0f)));
+		transform->scale = glm::vec3(0.25f + unit());
+		Scene::Object *object = scene.new_object(transform);
+		object->bounds_min = glm::vec3(-1.0f);
+		object->bounds_max = glm::vec3( 1.0f);
+		object->bounds_center = glm::vec3(0.0f);
+		object->bounds_radius = std::sqrt(3.0f);
+		objects.emplace_back(object);
+	}
+
+	//the scan applies the same tests as the index (world box for radius, sphere around the world box for cones):
+	auto world_box = [&scene](Scene::Object const *object, glm::vec3 *min, glm::vec3 *max) {
+		glm::mat4 const &to_world = scene.local_to_world(object->transform);
+		glm::vec3 center = glm::vec3(to_world * glm::vec4(0.5f * (object->bounds_min + object->bounds_max), 1.0f));
+		glm::mat3 abs_rs = glm::mat3(glm::abs(glm::vec3(to_world[0])), glm::abs(glm::vec3(to_world[1])), glm::abs(glm::vec3(to_world[2])));
+		glm::vec3 extent = abs_rs * (0.5f * (object->bounds_max - object->bounds_min));
+		*min = center - extent;
+		*max = center + extent;
+	};
+	auto in_radius = [](glm::vec3 const &point, float radius, glm::vec3 const &min, glm::vec3 const &max) {
+		glm::vec3 d = point - glm::clamp(point, min, max);
+		return glm::dot(d, d) <= radius * radius;
+	};
+	auto in_cone = [](glm::vec3 const &apex, glm::vec3 const &direction, float half_angle, float range, glm::vec3 const &min, glm::vec3 const &max) {
+		float cos_angle = std::cos(half_angle);
+		float sin_angle = std::sin(half_angle);
+		glm::vec3 center = 0.5f * (min + max);
+		float radius = 0.5f * glm::length(max - min);
+		glm::vec3 v = center - apex;
+		float length2 = glm::dot(v, v);
+		if (length2 > (range + radius) * (range + radius)) return false;
+		if (length2 <= radius * radius) return true;
+		float along = glm::dot(v, direction);
+		float perp = std::sqrt(std::max(0.0f, length2 - along * along));
+		if (along * cos_angle + perp * sin_angle < 0.0f) return false;
+		return perp * cos_angle - along * sin_angle <= radius;
+	};
+
+	uint32_t const Queries = 100;
+	float const Radius = 5.0f;
+	float const HalfAngle = glm::radians(30.0f);
+	float const Range = 10.0f;
+
+	QueriesResult result;
+	std::vector< Scene::Object * > found, scanned;
+	std::vector< glm::vec3 > mins(count), maxs(count);
+	for (uint32_t r = 0; r < options.repeats; ++r) {
+		for (uint32_t i = 0; i < count; i += 10) {
+			objects[i]->transform->position += glm::vec3(unit() - 0.5f, unit() - 0.5f, 0.0f);
+		}
+
+		auto before = std::chrono::high_resolution_clock::now();
+		scene.update_spatial_index();
+		result.update_ns = std::min(result.update_ns, elapsed_ns(before));
+
+		for (uint32_t i = 0; i < count; ++i) {
+			world_box(objects[i], &mins[i], &maxs[i]);
+		}
+
+		std::vector< glm::vec3 > points(Queries), directions(Queries);
+		for (uint32_t q = 0; q < Queries; ++q) {
+			points[q] = glm::vec3(Width * unit(), Width * unit(), 10.0f * unit());
+			directions[q] = glm::normalize(glm::vec3(unit() - 0.5f, unit() - 0.5f, unit() - 0.5f));
+		}
+
+		//(each query's results are sorted so they can be compared with the scan's)
+		auto compare = [&]() {
+			std::sort(found.begin(), found.end());
+			if (found != scanned) ++result.mismatches;
+			result.found += found.size();
+		};
+
+		double radius_ns = 0.0, radius_scan_ns = 0.0, cone_ns = 0.0, cone_scan_ns = 0.0;
+		result.found = 0;
+		result.mismatches = 0;
+		for (uint32_t q = 0; q < Queries; ++q) {
+			found.clear();
+			before = std::chrono::high_resolution_clock::now();
+			scene.query_radius(points[q], Radius, &found);
+			radius_ns += elapsed_ns(before);
+
+			scanned.clear();
+			before = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < count; ++i) {
+				if (in_radius(points[q], Radius, mins[i], maxs[i])) scanned.emplace_back(objects[i]);
+			}
+			radius_scan_ns += elapsed_ns(before);
+			std::sort(scanned.begin(), scanned.end());
+			compare();
+
+			found.clear();
+			before = std::chrono::high_resolution_clock::now();
+			scene.query_cone(points[q], directions[q], HalfAngle, Range, &found);
+			cone_ns += elapsed_ns(before);
+
+			scanned.clear();
+			before = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < count; ++i) {
+				if (in_cone(points[q], directions[q], HalfAngle, Range, mins[i], maxs[i])) scanned.emplace_back(objects[i]);
+			}
+			cone_scan_ns += elapsed_ns(before);
+			std::sort(scanned.begin(), scanned.end());
+			compare();
+		}
+		result.radius_ns = std::min(result.radius_ns, radius_ns / Queries);
+		result.radius_scan_ns = std::min(result.radius_scan_ns, radius_scan_ns / Queries);
+		result.cone_ns = std::min(result.cone_ns, cone_ns / Queries);
+		result.cone_scan_ns = std::min(result.cone_scan_ns, cone_scan_ns / Queries);
+	}
+	return result;
+}
+
+int main(int argc, char **argv) {
+	uint32_t max_objects = (argc > 1 ? uint32_t(std::atoi(argv[1])) : 100000);
+	Options options;
+	if (argc > 2) options.depth = uint32_t(std::atoi(argv[2]));
+	if (argc > 3) options.repeats = std::max(1, std::atoi(argv[3]));
+	for (int a = 4; a < argc; ++a) {
+		std::string arg = argv[a];
+		if (arg == "linked") options.linked = true;
+		else if (arg == "instanced") options.instanced = true;
+		else if (arg == "serial") options.serial = true;
+		else if (arg == "record") options.record = true;
+		else if (arg == "views") options.views = true;
+		else if (arg == "crates") options.crates = true;
+		else if (arg == "queries") options.queries = true;
+		else {
+			std::cerr << "Unknown option '" << arg << "' (expecting linked, instanced, serial, record, views, crates, or queries)." << std::endl;
+			return 1;
+		}
+	}
+
+	if (options.crates) {
+		std::cout << "crates level: draws over 24 views from the platforms, best of " << options.repeats << " frames\n";
+		float const ChunkSize = 4.0f; //(CratesMode's LEVEL_CHUNK_SIZE)
+		for (float chunk_size : {0.0f, ChunkSize}) {
+			CratesResult off = run_crates(chunk_size, false, options);
+			CratesResult on = run_crates(chunk_size, true, options);
+			std::cout << "  " << (chunk_size > 0.0f ? "chunked" : "unchunked") << " bake (" << on.baked << " baked objects): "
+				<< off.visible << " visible without occlusion culling, " << on.visible << " with ("
+				<< off.visible - on.visible << " culled); prepare " << off.prepare_ns / 1000.0 << " / " << on.prepare_ns / 1000.0 << " us\n";
+		}
+		return 0;
+	}
+
+	if (options.queries) {
+		std::cout << "spatial index: 100 radius and 100 cone queries per frame against a scan of every object, best of " << options.repeats << " frames\n";
+		uint32_t mismatches = 0;
+		for (uint32_t count = 1000; count <= max_objects; count *= 10) {
+			QueriesResult result = run_queries(count, options);
+			std::cout << "  " << count << " objects: update " << result.update_ns / count << " ns per object;"
+				<< " radius " << result.radius_ns << " ns per query (scan " << result.radius_scan_ns << "),"
+				<< " cone " << result.cone_ns << " (scan " << result.cone_scan_ns << ")\n";
+			std::cout << "    " << result.found << " objects found, " << result.mismatches << " queries differ from the scan\n";
+			mismatches += result.mismatches;
+		}
+		return (mismatches == 0 ? 0 : 1);
+	}
+
+	std::cout << "scene benchmark: hierarchy depth " << options.depth
+		<< ", " << (options.linked ? "linked" : "flat") << " transforms"
+		<< (options.instanced ? ", instancing" : "")
+		<< (options.serial ? ", one thread" : "")
+		<< (options.record ? ", recording" : "")
+		<< (options.views ? ", two views" : "")
+		<< ", best of " << options.repeats << " frames (ns per object)\n";
+
+	uint32_t differences = 0;
+	for (uint32_t count = 1000; count <= max_objects; count *= 10) {
+		Result result = run(count, options);
+		std::cout << "  " << count << " objects:";
+		if (!options.linked) {
+			std::cout << " transforms " << result.moving_ns / count << " (static " << result.static_ns / count << "),";
+		}
+		std::cout << " prepare " << result.prepare_ns / count
+			<< ", submit " << result.submit_ns / count << "\n";
+		std::cout << "    " << result.visible << " visible, " << result.draw_calls << " draw calls per frame, "
+			<< result.binds << " binds, " << result.upload_bytes / 1024 << " KiB uploaded";
+		if (options.record) std::cout << ", " << result.commands << " commands recorded";
+		std::cout << "\n";
+		if (options.record) {
+			std::cout << "    identical frames " << (result.frame_difference == -1U ? "match" : "differ at command " + std::to_string(result.frame_difference))
+				<< ", replay " << (result.replay_difference == -1U ? "matches" : "differs at command " + std::to_string(result.replay_difference)) << "\n";
+			if (result.frame_difference != -1U) ++differences;
+			if (result.replay_difference != -1U) ++differences;
+		}
+	}
+
+	return (differences == 0 ? 0 : 1);
+}
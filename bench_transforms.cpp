@@ -0,0 +1,179 @@
+//Microbenchmark: transform_kernels vs. the plain glm matrix-product path they replace.
+//Build with 'jam bench_transforms'; run as 'bench/bench_transforms [count] [repeats]'.
+
+#include "transform_kernels.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+//the glm path, as Scene used to compute it:
+static glm::mat4 glm_local_to_parent(glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
+	return glm::mat4( //translate
+		glm::vec4(1.0f, 0.0f, 0.0f, 0.0f),
+		glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+		glm::vec4(position, 1.0f)
+	)
+	* glm::mat4_cast(rotation) //rotate
+	* glm::mat4( //scale
+		glm::vec4(scale.x, 0.0f, 0.0f, 0.0f),
+		glm::vec4(0.0f, scale.y, 0.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, scale.z, 0.0f),
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+	);
+}
+
+static glm::mat4 glm_parent_to_local(glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
+	glm::vec3 inv_scale;
+	inv_scale.x = (scale.x == 0.0f ? 0.0f : 1.0f / scale.x);
+	inv_scale.y = (scale.y == 0.0f ? 0.0f : 1.0f / scale.y);
+	inv_scale.z = (scale.z == 0.0f ? 0.0f : 1.0f / scale.z);
+	return glm::mat4( //un-scale
+		glm::vec4(inv_scale.x, 0.0f, 0.0f, 0.0f),
+		glm::vec4(0.0f, inv_scale.y, 0.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, inv_scale.z, 0.0f),
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+	)
+	* glm::mat4_cast(glm::inverse(rotation)) //un-rotate
+	* glm::mat4( //un-translate
+		glm::vec4(1.0f, 0.0f, 0.0f, 0.0f),
+		glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+		glm::vec4(-position, 1.0f)
+	);
+}
+
+//run 'fn' 'repeats' times, report the best time per item:
+template< typename F >
+static double time_per_item(uint32_t count, uint32_t repeats, F const &fn) {
+	double best = std::numeric_limits< double >::infinity();
+	for (uint32_t r = 0; r < repeats; ++r) {
+		auto before = std::chrono::high_resolution_clock::now();
+		fn();
+		auto after = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration< double, std::nano >(after - before).count());
+	}
+	return best / count;
+}
+
+static float max_difference(std::vector< glm::mat4 > const &a, std::vector< glm::mat4 > const &b) {
+	float ret = 0.0f;
+	for (uint32_t i = 0; i < a.size(); ++i) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			for (uint32_t r = 0; r < 4; ++r) {
+				ret = std::max(ret, std::abs(a[i][c][r] - b[i][c][r]));
+			}
+		}
+	}
+	return ret;
+}
+
+static float max_difference(std::vector< glm::mat3 > const &a, std::vector< glm::mat3 > const &b) {
+	float ret = 0.0f;
+	for (uint32_t i = 0; i < a.size(); ++i) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			for (uint32_t r = 0; r < 3; ++r) {
+				ret = std::max(ret, std::abs(a[i][c][r] - b[i][c][r]));
+			}
+		}
+	}
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	uint32_t count = (argc > 1 ? uint32_t(std::atoi(argv[1])) : 100000);
+	uint32_t repeats = (argc > 2 ? uint32_t(std::atoi(argv[2])) : 20);
+
+	//random transforms; half with uniform scale:
+	std::mt19937 mt(0xfeedf00d);
+	std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+	std::vector< glm::vec3 > positions(count);
+	std::vector< glm::quat > rotations(count);
+	std::vector< glm::vec3 > scales(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		positions[i] = 10.0f * glm::vec3(unit(mt), unit(mt), unit(mt));
+		rotations[i] = glm::normalize(glm::quat(unit(mt), unit(mt), unit(mt), unit(mt)));
+		float s = 1.5f + unit(mt);
+		scales[i] = (i % 2 ? glm::vec3(s) : glm::vec3(s, 1.5f + unit(mt), 1.5f + unit(mt)));
+	}
+
+	std::vector< glm::mat4 > reference(count);
+	std::vector< glm::mat4 > kernel(count);
+	std::vector< glm::mat3 > reference_normals(count);
+	std::vector< glm::mat3 > kernel_normals(count);
+
+	std::cout << "transforms: " << count << ", best of " << repeats << " runs (ns per transform)\n";
+
+	auto report = [](std::string const &name, double glm_ns, double kernel_ns, float difference) {
+		std::cout << "  " << name << ": glm " << glm_ns << ", kernel " << kernel_ns
+			<< " (" << glm_ns / kernel_ns << "x), max difference " << difference << "\n";
+	};
+
+	{ //local-to-parent:
+		double glm_ns = time_per_item(count, repeats, [&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				reference[i] = glm_local_to_parent(positions[i], rotations[i], scales[i]);
+			}
+		});
+		double kernel_ns = time_per_item(count, repeats, [&](){
+			make_local_to_parent(count, positions.data(), rotations.data(), scales.data(), kernel.data());
+		});
+		report("local_to_parent", glm_ns, kernel_ns, max_difference(reference, kernel));
+	}
+
+	{ //parent-to-local:
+		double glm_ns = time_per_item(count, repeats, [&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				reference[i] = glm_parent_to_local(positions[i], rotations[i], scales[i]);
+			}
+		});
+		double kernel_ns = time_per_item(count, repeats, [&](){
+			make_parent_to_local(count, positions.data(), rotations.data(), scales.data(), kernel.data());
+		});
+		report("parent_to_local", glm_ns, kernel_ns, max_difference(reference, kernel));
+	}
+
+	{ //compose with a parent:
+		glm::mat4 parent = glm_local_to_parent(glm::vec3(1.0f, 2.0f, 3.0f), glm::normalize(glm::quat(0.5f, 0.1f, 0.2f, 0.3f)), glm::vec3(2.0f));
+		std::vector< glm::mat4 > locals = reference;
+		double glm_ns = time_per_item(count, repeats, [&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				reference[i] = parent * locals[i];
+			}
+		});
+		double kernel_ns = time_per_item(count, repeats, [&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				kernel[i] = multiply_affine(parent, locals[i]);
+			}
+		});
+		report("multiply_affine", glm_ns, kernel_ns, max_difference(reference, kernel));
+	}
+
+	{ //normal matrices (half uniform scale):
+		make_local_to_parent(count, positions.data(), rotations.data(), scales.data(), kernel.data());
+		std::vector< glm::mat4 > matrices = kernel;
+		double glm_ns = time_per_item(count, repeats, [&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				reference_normals[i] = glm::inverse(glm::transpose(glm::mat3(matrices[i])));
+			}
+		});
+		double kernel_ns = time_per_item(count, repeats, [&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				kernel_normals[i] = make_normal_matrix(matrices[i]);
+			}
+		});
+		report("normal_matrix", glm_ns, kernel_ns, max_difference(reference_normals, kernel_normals));
+	}
+
+	return 0;
+}
@@ -0,0 +1,263 @@
+//Microbenchmark: WalkMesh walking and closest-point search, run headless on the level's walk mesh.
+//Build with 'jam bench_walkmesh'; run as 'bench/bench_walkmesh [agents] [repeats]' from the repository root.
+//Agents start at random spots on dist/phone-bank-walk.pnc and take random steps (mostly short, some long enough to cross triangles);
+// the batched walk() (one thread and all threads) is checked against calling the scalar walk() for each agent,
+// since it promises exactly the same results, and all three are timed.
+//start() (BVH search) is checked against, and timed with, a scan of every triangle in double precision, on the level's
+// walk mesh and on a generated mesh (written to the working directory, then removed) whose triangles are all repeated
+// -- so exact ties must go to the lower index -- followed by degenerate triangles (a repeated corner, three corners
+// on a line, and all corners at one point).
+
+#include "WalkMesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <fstream>
+#include <cstdio>
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+//run 'fn' 'repeats' times, report the best time in nanoseconds:
+template< typename F >
+static double best_time(uint32_t repeats, F const &fn) {
+	double best = std::numeric_limits< double >::infinity();
+	for (uint32_t r = 0; r < repeats; ++r) {
+		auto before = std::chrono::high_resolution_clock::now();
+		fn();
+		auto after = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration< double, std::nano >(after - before).count());
+	}
+	return best;
+}
+
+//squared distance from p to the closest point on triangle abc, in double precision, without shortcuts
+// (closest of the three edges and, if the triangle has area and p projects inside it, the projection):
+static double closest_dist2(glm::vec3 const &p_, glm::vec3 const &a_, glm::vec3 const &b_, glm::vec3 const &c_) {
+	struct D3 { double x, y, z; };
+	auto d3 = [](glm::vec3 const &v) { return D3{v.x, v.y, v.z}; };
+	auto sub = [](D3 a, D3 b) { return D3{a.x - b.x, a.y - b.y, a.z - b.z}; };
+	auto dot = [](D3 a, D3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; };
+	auto cross = [](D3 a, D3 b) { return D3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; };
+	D3 p = d3(p_), a = d3(a_), b = d3(b_), c = d3(c_);
+
+	auto segment_dist2 = [&](D3 s, D3 e) {
+		D3 d = sub(e, s);
+		double length2 = dot(d, d);
+		double t = (length2 > 0.0 ? std::max(0.0, std::min(1.0, dot(sub(p, s), d) / length2)) : 0.0);
+		D3 q = sub(p, D3{s.x + t * d.x, s.y + t * d.y, s.z + t * d.z});
+		return dot(q, q);
+	};
+	double best = std::min(segment_dist2(a, b), std::min(segment_dist2(a, c), segment_dist2(b, c)));
+
+	D3 n = cross(sub(b, a), sub(c, a));
+	double n2 = dot(n, n);
+	if (n2 > 0.0) {
+		//inside when p is on the inner side of all three edges:
+		if (dot(cross(sub(b, a), sub(p, a)), n) >= 0.0
+		 && dot(cross(sub(c, b), sub(p, b)), n) >= 0.0
+		 && dot(cross(sub(a, c), sub(p, c)), n) >= 0.0) {
+			double h = dot(sub(p, a), n);
+			best = std::min(best, h * h / n2);
+		}
+	}
+	return best;
+}
+
+//walk points match when they are bit-for-bit the same:
+static bool same(WalkPoint const &a, WalkPoint const &b) {
+	return a.triangle == b.triangle && std::memcmp(&a.weights, &b.weights, sizeof(a.weights)) == 0;
+}
+
+int main(int argc, char **argv) {
+	uint32_t agents = (argc > 1 ? uint32_t(std::atoi(argv[1])) : 10000);
+	uint32_t repeats = (argc > 2 ? uint32_t(std::max(1, std::atoi(argv[2]))) : 20);
+
+	WalkMesh mesh("dist/phone-bank-walk.pnc");
+	glm::vec3 min = mesh.bvh[0].min;
+	glm::vec3 max = mesh.bvh[0].max;
+
+	//agents at random spots, snapped onto the mesh:
+	std::mt19937 mt(0xfeedf00d);
+	std::uniform_real_distribution< float > unit(0.0f, 1.0f);
+	std::vector< WalkPoint > start(agents);
+	for (auto &wp : start) {
+		wp = mesh.start(min + (max - min) * glm::vec3(unit(mt), unit(mt), unit(mt)));
+	}
+
+	//one step per agent per round: nine in ten are a frame's worth of walking, the rest long enough to cross several triangles:
+	std::vector< glm::vec3 > steps(agents);
+	auto make_steps = [&]() {
+		for (auto &step : steps) {
+			float length = (unit(mt) < 0.9f ? 0.1f : 2.0f) * unit(mt);
+			float angle = 6.2831853f * unit(mt);
+			step = length * glm::vec3(std::cos(angle), std::sin(angle), 0.2f * (unit(mt) - 0.5f));
+		}
+	};
+
+	//every round, walk the same steps from the same points all three ways and compare:
+	std::vector< WalkPoint > scalar = start, serial = start, threaded = start;
+	uint32_t mismatches = 0;
+	double scalar_ns = std::numeric_limits< double >::infinity();
+	double serial_ns = std::numeric_limits< double >::infinity();
+	double threaded_ns = std::numeric_limits< double >::infinity();
+	for (uint32_t r = 0; r < repeats; ++r) {
+		make_steps();
+		std::vector< WalkPoint > before = scalar;
+		scalar_ns = std::min(scalar_ns, best_time(1, [&](){
+			for (uint32_t i = 0; i < agents; ++i) {
+				mesh.walk(scalar[i], steps[i]);
+			}
+		}));
+		serial = before;
+		serial_ns = std::min(serial_ns, best_time(1, [&](){
+			mesh.walk(agents, serial.data(), steps.data(), 1);
+		}));
+		threaded = before;
+		threaded_ns = std::min(threaded_ns, best_time(1, [&](){
+			mesh.walk(agents, threaded.data(), steps.data(), 0);
+		}));
+		for (uint32_t i = 0; i < agents; ++i) {
+			if (!same(scalar[i], serial[i]) || !same(scalar[i], threaded[i])) ++mismatches;
+		}
+	}
+
+	std::cout << agents << " agents, " << repeats << " rounds of steps (best round)\n";
+	std::cout << "  walk, one agent at a time: " << scalar_ns / agents << " ns per agent\n";
+	std::cout << "  walk, batched: " << serial_ns / agents << " ns per agent (one thread), "
+		<< threaded_ns / agents << " (all threads)\n";
+	std::cout << "  " << mismatches << " batched walk points differ from walking one at a time\n";
+
+	//start() against a scan of every triangle, for points scattered around (and past) a mesh's bounds:
+	// 'duplicates' is the number of triangles repeated right after themselves (so triangle t + duplicates must never be found);
+	// returns the number of wrong answers:
+	auto check_start = [&](char const *name, WalkMesh const &mesh, uint32_t count, uint32_t duplicates) {
+		glm::vec3 min = mesh.bvh[0].min;
+		glm::vec3 max = mesh.bvh[0].max;
+		glm::vec3 margin = 0.25f * (max - min) + glm::vec3(1.0f);
+		std::vector< glm::vec3 > points(count);
+		for (auto &p : points) {
+			p = (min - margin) + (max - min + 2.0f * margin) * glm::vec3(unit(mt), unit(mt), unit(mt));
+		}
+		//(and some right on corners, where several triangles tie)
+		for (uint32_t i = 0; i < count / 8; ++i) {
+			points[i] = mesh.vertices[mt() % mesh.vertices.size()];
+		}
+
+		std::vector< WalkPoint > found(count), found_threaded(count);
+		double bvh_ns = best_time(repeats, [&](){
+			mesh.start(count, points.data(), found.data(), 1);
+		});
+		double bvh_threaded_ns = best_time(repeats, [&](){
+			mesh.start(count, points.data(), found_threaded.data(), 0);
+		});
+
+		std::vector< double > scanned(count);
+		double scan_ns = best_time(1, [&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				double best = std::numeric_limits< double >::infinity();
+				for (auto const &tri : mesh.triangles) {
+					best = std::min(best, closest_dist2(points[i], mesh.vertices[tri.x], mesh.vertices[tri.y], mesh.vertices[tri.z]));
+				}
+				scanned[i] = best;
+			}
+		});
+
+		//the point found must be on its triangle and (up to float rounding) as close as the closest point the scan found:
+		uint32_t wrong = 0, ties_lost = 0;
+		float scale = glm::length(glm::max(glm::abs(min - margin), glm::abs(max + margin)));
+		for (uint32_t i = 0; i < count; ++i) {
+			WalkPoint const &wp = found[i];
+			bool ok = same(wp, found_threaded[i]) && wp.triangle < mesh.triangles.size();
+			if (ok) {
+				glm::vec3 w = wp.weights;
+				ok = (w.x >= -1e-4f && w.y >= -1e-4f && w.z >= -1e-4f && std::abs(w.x + w.y + w.z - 1.0f) <= 1e-4f);
+			}
+			if (ok) {
+				double distance = std::sqrt(double(glm::dot(points[i] - mesh.world_point(wp), points[i] - mesh.world_point(wp))));
+				ok = (std::abs(distance - std::sqrt(scanned[i])) <= 1e-5 * scale);
+			}
+			if (ok && wp.triangle >= duplicates && wp.triangle < 2 * duplicates) {
+				++ties_lost;
+				ok = false;
+			}
+			if (!ok) ++wrong;
+		}
+
+		std::cout << "  start, " << name << " (" << mesh.triangles.size() << " triangles): "
+			<< bvh_ns / count << " ns per point (one thread), " << bvh_threaded_ns / count << " (all threads), "
+			<< "scan " << scan_ns / count << "\n";
+		std::cout << "    " << wrong << " of " << count << " points wrong";
+		if (duplicates) std::cout << " (" << ties_lost << " found a repeated triangle instead of the lower-indexed original)";
+		std::cout << "\n";
+		return wrong;
+	};
+
+	uint32_t wrong = check_start("level", mesh, 10000, 0);
+
+	//a bumpy 16x16 grid, every triangle twice, then degenerate triangles floating over it:
+	{
+		struct Vertex {
+			glm::vec3 Position;
+			glm::vec3 Normal;
+			glm::u8vec4 Color;
+		};
+		static_assert(sizeof(Vertex) == 3*4+3*4+4*1, "Vertex is packed.");
+		std::vector< Vertex > vertex_data;
+		auto triangle = [&](glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+			for (glm::vec3 const &v : {a, b, c}) {
+				vertex_data.emplace_back(Vertex{v, glm::vec3(0.0f, 0.0f, 1.0f), glm::u8vec4(0xff)});
+			}
+		};
+		uint32_t const Cells = 16;
+		std::vector< float > heights((Cells + 1) * (Cells + 1));
+		for (auto &h : heights) h = 0.5f * unit(mt);
+		auto at = [&](uint32_t x, uint32_t y) { return glm::vec3(float(x), float(y), heights[y * (Cells + 1) + x]); };
+		for (uint32_t y = 0; y < Cells; ++y) {
+			for (uint32_t x = 0; x < Cells; ++x) {
+				triangle(at(x, y), at(x+1, y), at(x+1, y+1));
+				triangle(at(x, y), at(x+1, y+1), at(x, y+1));
+			}
+		}
+		uint32_t duplicates = uint32_t(vertex_data.size() / 3);
+		vertex_data.insert(vertex_data.end(), vertex_data.begin(), vertex_data.end());
+		for (uint32_t d = 0; d < 8; ++d) {
+			glm::vec3 a = glm::vec3(float(Cells) * unit(mt), float(Cells) * unit(mt), 1.0f + unit(mt));
+			glm::vec3 b = a + glm::vec3(unit(mt), unit(mt), unit(mt));
+			triangle(a, a, b); //repeated corner
+			triangle(a, b, 0.5f * (a + b)); //corners on a line
+			triangle(b, b, b); //one point
+		}
+
+		std::vector< uint32_t > triangle_data;
+		for (uint32_t v = 0; v < vertex_data.size(); v += 3) {
+			triangle_data.emplace_back(v);
+		}
+		char const *filename = "bench_walkmesh-generated.pnc";
+		{
+			std::ofstream file(filename, std::ios::binary);
+			auto write_chunk = [&file](char const *magic, void const *data, uint32_t size) {
+				file.write(magic, 4);
+				file.write(reinterpret_cast< char const * >(&size), 4);
+				file.write(reinterpret_cast< char const * >(data), size);
+			};
+			char const names[4] = {'n', 'o', 'n', 'e'};
+			write_chunk("pnc.", vertex_data.data(), uint32_t(vertex_data.size() * sizeof(Vertex)));
+			write_chunk("str0", names, sizeof(names));
+			write_chunk("idx0", names, sizeof(names));
+			write_chunk("tri0", triangle_data.data(), uint32_t(triangle_data.size() * sizeof(uint32_t)));
+		}
+		WalkMesh generated(filename);
+		std::remove(filename);
+		wrong += check_start("generated", generated, 10000, duplicates);
+	}
+
+	return (mismatches == 0 && wrong == 0 ? 0 : 1);
+}
@@ -5,6 +5,7 @@
 #include "MeshBuffer.hpp"
 #include "data_path.hpp"
 #include "compile_program.hpp"
+#include "RenderDevice.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -63,8 +64,10 @@ Load< GLuint > text_meshes_for_text_program(LoadTagDefault, [](){
 
 
 void draw_text(std::string const &text, glm::vec2 const &anchor, float height, glm::vec4 color) {
+	RenderDevice &device = *RenderDevice::current;
+
 	GLint viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
+	device.get_viewport(viewport);
 	float aspect = viewport[2] / float(viewport[3]);
 
 	draw_text(text,
@@ -77,8 +80,10 @@ void draw_text(std::string const &text, glm::vec2 const &anchor, float height, g
 }
 
 void draw_text(std::string const &text, glm::mat4 const &transform, glm::vec4 color) {
-	glUseProgram(*text_program);
-	glBindVertexArray(*text_meshes_for_text_program);
+	RenderDevice &device = *RenderDevice::current;
+
+	device.use_program(*text_program);
+	device.bind_vertex_array(*text_meshes_for_text_program);
 
 	float x = 0.0f;
 	for (uint32_t i = 0; i < text.size(); ++i) {
@@ -91,19 +96,19 @@ void draw_text(std::string const &text, glm::mat4 const &transform, glm::vec4 co
 				glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
 				glm::vec4(s * x, 0.0f, 0.0f, 1.0f)
 			);
-			glUniformMatrix4fv(text_program_mvp_mat4, 1, GL_FALSE, glm::value_ptr(mvp));
-			glUniform4fv(text_program_color_vec4, 1, glm::value_ptr(color));
+			device.uniform(text_program_mvp_mat4, mvp);
+			device.uniform(text_program_color_vec4, color);
 
 			MeshBuffer::Mesh const &mesh = text_meshes->lookup(text.substr(i,1));
-			glDrawArrays(GL_TRIANGLES, mesh.start, mesh.count);
+			device.draw_arrays(GL_TRIANGLES, mesh.start, mesh.count);
 		}
 
 		x += char_width(text[i]);
 	}
 
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+	device.bind_vertex_array(0);
+	device.use_program(0);
 }
 
 float text_width(std::string const &text, float height) {
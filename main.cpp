@@ -13,6 +13,9 @@
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
+//RenderDevice.hpp has the device that drawing goes through:
+#include "RenderDevice.hpp"
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -28,10 +31,14 @@
 #include <fstream>
 #include <memory>
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cassert>
 
 int main(int argc, char **argv) {
 	struct {
-		std::string title = "Another Infinite Night at the Orbital Phone Bank"";
+		std::string title = "Another Infinite Night at the Orbital Phone Bank";
 		glm::uvec2 size = glm::uvec2(640, 400);
 	} config;
 
@@ -120,10 +127,55 @@ int main(int argc, char **argv) {
 		window_size = glm::uvec2(w, h);
 		SDL_GL_GetDrawableSize(window, &w, &h);
 		drawable_size = glm::uvec2(w, h);
-		glViewport(0, 0, drawable_size.x, drawable_size.y);
+		RenderDevice::current->viewport(0, 0, drawable_size.x, drawable_size.y);
 	};
 	on_resize();
 
+	//mode whose sync() last ran (overlapped modes are synced once before their first overlapped update):
+	std::shared_ptr< Mode > synced;
+
+	//overlapped updates run on one long-lived thread, which sleeps between frames:
+	struct UpdateWorker {
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::shared_ptr< Mode > mode; //(set while an update is pending or running)
+		float elapsed = 0.0f;
+		bool quit = false;
+		std::thread thread; //(last, so it starts after the members it reads)
+
+		UpdateWorker() : thread([this](){
+			std::unique_lock< std::mutex > lock(mutex);
+			while (true) {
+				cv.wait(lock, [this](){ return mode || quit; });
+				if (!mode) return;
+				lock.unlock();
+				mode->update(elapsed);
+				lock.lock();
+				mode = nullptr;
+				cv.notify_all();
+			}
+		}) { }
+		~UpdateWorker() {
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				quit = true;
+			}
+			cv.notify_all();
+			thread.join();
+		}
+		void start(std::shared_ptr< Mode > const &mode_, float elapsed_) {
+			std::unique_lock< std::mutex > lock(mutex);
+			assert(!mode && "previous update should be finished");
+			mode = mode_;
+			elapsed = elapsed_;
+			cv.notify_all();
+		}
+		void finish() {
+			std::unique_lock< std::mutex > lock(mutex);
+			cv.wait(lock, [this](){ return !mode; });
+		}
+	} update_worker;
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
@@ -147,6 +199,9 @@ int main(int argc, char **argv) {
 			if (!Mode::current) break;
 		}
 
+		//modes that allow it update the next frame on another thread while this one draws:
+		std::shared_ptr< Mode > overlapped = (Mode::current->overlap_update() ? Mode::current : nullptr);
+
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
@@ -157,19 +212,35 @@ int main(int argc, char **argv) {
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
-			Mode::current->update(elapsed);
-			if (!Mode::current) break;
+			if (overlapped) {
+				if (synced != overlapped) {
+					overlapped->sync();
+					synced = overlapped;
+				}
+				update_worker.start(overlapped, elapsed);
+			} else {
+				synced = nullptr;
+				Mode::current->update(elapsed);
+				if (!Mode::current) break;
+			}
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
 			//clear the depth+color buffers and set some default state:
-			glClearColor(0.5, 0.5, 0.5, 0.0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glEnable(GL_DEPTH_TEST);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			RenderDevice &device = *RenderDevice::current;
+			device.clear_color(glm::vec4(0.5f, 0.5f, 0.5f, 0.0f));
+			device.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			device.enable(GL_DEPTH_TEST);
+			device.enable(GL_BLEND);
+			device.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+			//(an overlapped mode draws what its last sync() captured)
+			(overlapped ? overlapped : Mode::current)->draw(drawable_size);
+		}
 
-			Mode::current->draw(drawable_size);
+		if (overlapped) {
+			update_worker.finish();
+			overlapped->sync();
 		}
 
 		//Finally, wait until the recently-drawn frame is shown before doing it all again:
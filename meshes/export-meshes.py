@@ -3,7 +3,7 @@
 #based on 'export-sprites.py' and 'glsprite.py' from TCHOW Rainbow; code used is released into the public domain.
 
 #Note: Script meant to be executed from within blender, as per:
-#blender --background --python export-meshes.py -- <infile.blend>[:layer] <outfile.p[n][c][t]>
+#blender --background --python export-meshes.py -- <infile.blend>[:layer] <outfile.p[n][c][t]> [lod-levels]
 
 import sys,re
 
@@ -12,8 +12,8 @@ for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
-if len(args) != 2:
-	print("\n\nUsage:\nblender --background --python export-navmesh.py -- <infile.blend>[:layer] <outfile.p[n][c][t][l]>\nExports the meshes referenced by all objects in layer (default 1) to a binary blob, indexed by the names of the objects that reference them. If 'l' is specified in the file extension, only mesh edges will be exported.\n")
+if len(args) != 2 and len(args) != 3:
+	print("\n\nUsage:\nblender --background --python export-navmesh.py -- <infile.blend>[:layer] <outfile.p[n][c][t][l]> [lod-levels]\nExports the meshes referenced by all objects in layer (default 1) to a binary blob, indexed by the names of the objects that reference them. If 'l' is specified in the file extension, only mesh edges will be exported.\nIf lod-levels (default 0) is given, each mesh also gets that many reduced levels of detail, indexed as '<name>.lod1', '<name>.lod2', ..., each with about half the triangles of the one before.\n")
 	exit(1)
 
 infile = args[0]
@@ -23,8 +23,12 @@ if m:
 	infile = m.group(1)
 	layer = int(m.group(2))
 outfile = args[1]
+lod_levels = 0
+if len(args) == 3:
+	lod_levels = int(args[2])
 
 assert layer >= 1 and layer <= 20
+assert lod_levels >= 0
 
 print("Will export meshes referenced from layer " + str(layer) + " of '" + infile + "' to '" + outfile + "'.")
 
@@ -92,6 +96,85 @@ index = b''
 #triangle gives offsets into data for triangles:
 triangles = b''
 
+#append the triangles of an (already triangulated) mesh to data:
+# if record_triangles, also note them in the 'tri0' chunk (used by walk meshes; only base meshes are recorded)
+def write_triangles(obj, mesh, record_triangles):
+	global data, triangles, vertex_count
+
+	colors = None
+	if filetype.color:
+		if len(mesh.vertex_colors) == 0:
+			print("WARNING: trying to export color data, but object '" + obj.name + "' does not have color data; will output 0xffffffff")
+		else:
+			colors = mesh.vertex_colors.active.data
+
+	uvs = None
+	if filetype.texcoord:
+		if len(mesh.uv_layers) == 0:
+			print("WARNING: trying to export texcoord data, but object '" + obj.name + "' does not uv data; will output (0.0, 0.0)")
+		else:
+			uvs = mesh.uv_layers.active.data
+
+	for poly in mesh.polygons:
+		assert(len(poly.loop_indices) == 3)
+		if record_triangles:
+			triangles += struct.pack('I', vertex_count);
+		for i in range(0,3):
+			assert(mesh.loops[poly.loop_indices[i]].vertex_index == poly.vertices[i])
+			loop = mesh.loops[poly.loop_indices[i]]
+			vertex = mesh.vertices[loop.vertex_index]
+			for x in vertex.co:
+				data += struct.pack('f', x)
+			if filetype.normal:
+				for x in loop.normal:
+					data += struct.pack('f', x)
+			if filetype.color:
+				if colors != None:
+					col = colors[poly.loop_indices[i]].color
+					data += struct.pack('BBBB', int(col.r * 255), int(col.g * 255), int(col.b * 255), 255)
+				else:
+					data += struct.pack('BBBB', 255, 255, 255, 255)
+			if filetype.texcoord:
+				if uvs != None:
+					uv = uvs[poly.loop_indices[i]].uv
+					data += struct.pack('ff', uv.x, uv.y)
+				else:
+					data += struct.pack('ff', 0, 0)
+		vertex_count += 3
+
+#append a reduced copy of obj's (triangulated) mesh, indexed as '<name>.lod<level>':
+def write_lod(obj, name, level):
+	global strings, index
+
+	#decimate a copy, collapsing edges by quadric error (Blender's 'COLLAPSE' decimation):
+	lod = obj.copy()
+	lod.data = obj.data.copy()
+	bpy.context.scene.objects.link(lod)
+	bpy.ops.object.select_all(action='DESELECT')
+	lod.select = True
+	bpy.context.scene.objects.active = lod
+	decimate = lod.modifiers.new(name='LOD', type='DECIMATE')
+	decimate.decimate_type = 'COLLAPSE'
+	decimate.ratio = 0.5 ** level
+	decimate.use_collapse_triangulate = True
+	bpy.ops.object.modifier_apply(modifier=decimate.name)
+	lod.data.calc_normals_split()
+
+	lod_name = name + ".lod" + str(level)
+	print("  Writing '" + lod_name + "' (" + str(len(lod.data.polygons)) + " of " + str(len(obj.data.polygons)) + " triangles)...")
+	name_begin = len(strings)
+	strings += bytes(lod_name, "utf8")
+	name_end = len(strings)
+	index += struct.pack('I', name_begin)
+	index += struct.pack('I', name_end)
+	index += struct.pack('I', vertex_count) #vertex_begin
+	write_triangles(lod, lod.data, False)
+	index += struct.pack('I', vertex_count) #vertex_end
+
+	lod_mesh = lod.data
+	bpy.data.objects.remove(lod)
+	bpy.data.meshes.remove(lod_mesh)
+
 vertex_count = 0
 for obj in bpy.data.objects:
 	if obj.data in to_write:
@@ -135,47 +218,8 @@ for obj in bpy.data.objects:
 	index += struct.pack('I', vertex_count) #vertex_begin
 	#...count will be written below
 
-	colors = None
-	if filetype.color:
-		if len(obj.data.vertex_colors) == 0:
-			print("WARNING: trying to export color data, but object '" + name + "' does not have color data; will output 0xffffffff")
-		else:
-			colors = obj.data.vertex_colors.active.data
-
-	uvs = None
-	if filetype.texcoord:
-		if len(obj.data.uv_layers) == 0:
-			print("WARNING: trying to export texcoord data, but object '" + name + "' does not uv data; will output (0.0, 0.0)")
-		else:
-			uvs = obj.data.uv_layers.active.data
-
 	if not filetype.as_lines:
-		#write the mesh triangles:
-		for poly in mesh.polygons:
-			assert(len(poly.loop_indices) == 3)
-			triangles += struct.pack('I', vertex_count);
-			for i in range(0,3):
-				assert(mesh.loops[poly.loop_indices[i]].vertex_index == poly.vertices[i])
-				loop = mesh.loops[poly.loop_indices[i]]
-				vertex = mesh.vertices[loop.vertex_index]
-				for x in vertex.co:
-					data += struct.pack('f', x)
-				if filetype.normal:
-					for x in loop.normal:
-						data += struct.pack('f', x)
-				if filetype.color:
-					if colors != None:
-						col = colors[poly.loop_indices[i]].color
-						data += struct.pack('BBBB', int(col.r * 255), int(col.g * 255), int(col.b * 255), 255)
-					else:
-						data += struct.pack('BBBB', 255, 255, 255, 255)
-				if filetype.texcoord:
-					if uvs != None:
-						uv = uvs[poly.loop_indices[i]].uv
-						data += struct.pack('ff', uv.x, uv.y)
-					else:
-						data += struct.pack('ff', 0, 0)
-			vertex_count += 3
+		write_triangles(obj, mesh, True)
 	else:
 		#write the mesh edges:
 		for edge in mesh.edges:
@@ -192,6 +236,10 @@ for obj in bpy.data.objects:
 
 	index += struct.pack('I', vertex_count) #vertex_end
 
+	if not filetype.as_lines:
+		for level in range(1, lod_levels+1):
+			write_lod(obj, name, level)
+
 
 #check that we wrote as much data as anticipated:
 assert(vertex_count * filetype.vertex_bytes == len(data))
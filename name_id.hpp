@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+//"name_id" hashes a name (32-bit FNV-1a) so it can be stored, compared, and looked up as an integer.
+//It is constexpr, so the ids of string literals can be computed at compile time:
+//   switch (object->name) { case name_id("Player"): ... }
+//(Scene::intern() checks that distinct names used in a scene don't share an id.)
+typedef uint32_t NameID;
+
+enum : uint32_t {
+	NameIDBasis = 2166136261U,
+	NameIDPrime = 16777619U,
+};
+
+//(written as a single recursive return so it is a valid C++11 constexpr function)
+constexpr NameID name_id(char const *name, NameID hash = NameIDBasis) {
+	return (*name == '\0' ? hash : name_id(name + 1, (hash ^ NameID(uint8_t(*name))) * NameIDPrime));
+}
+
+//same hash, for names that aren't null-terminated:
+inline NameID name_id(char const *begin, char const *end) {
+	NameID hash = NameIDBasis;
+	for (char const *c = begin; c != end; ++c) {
+		hash = (hash ^ NameID(uint8_t(*c))) * NameIDPrime;
+	}
+	return hash;
+}
+
+inline NameID name_id(std::string const &name) {
+	return name_id(name.data(), name.data() + name.size());
+}
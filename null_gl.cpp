@@ -0,0 +1,130 @@
+#include "null_gl.hpp"
+
+#include "GL.hpp"
+
+NullGLCounts null_gl_counts;
+
+namespace {
+GLuint next_name = 1;
+void gen_names(GLsizei n, GLuint *names) {
+	for (GLsizei i = 0; i < n; ++i) {
+		names[i] = next_name++;
+	}
+}
+}
+
+//------ state ------
+
+void glViewport(GLint, GLint, GLsizei, GLsizei) {
+}
+void glScissor(GLint, GLint, GLsizei, GLsizei) {
+}
+void glClearColor(GLfloat, GLfloat, GLfloat, GLfloat) {
+}
+void glClear(GLbitfield) {
+}
+void glEnable(GLenum) {
+}
+void glDisable(GLenum) {
+}
+void glBlendEquation(GLenum) {
+}
+void glBlendFunc(GLenum, GLenum) {
+}
+
+void glGetIntegerv(GLenum pname, GLint *data) {
+	if (pname == GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT) {
+		*data = 256;
+	} else if (pname == GL_VIEWPORT) {
+		data[0] = 0; data[1] = 0; data[2] = 640; data[3] = 400;
+	} else {
+		*data = 0;
+	}
+}
+
+//------ buffers ------
+
+void glGenBuffers(GLsizei n, GLuint *buffers) {
+	gen_names(n, buffers);
+}
+void glDeleteBuffers(GLsizei, GLuint const *) {
+}
+void glBindBuffer(GLenum, GLuint) {
+	++null_gl_counts.buffer_binds;
+}
+void glBindBufferRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr) {
+	++null_gl_counts.buffer_binds;
+}
+void glBufferData(GLenum, GLsizeiptr size, void const *, GLenum) {
+	++null_gl_counts.upload_calls;
+	null_gl_counts.upload_bytes += uint64_t(size);
+}
+void glBufferSubData(GLenum, GLintptr, GLsizeiptr size, void const *) {
+	++null_gl_counts.upload_calls;
+	null_gl_counts.upload_bytes += uint64_t(size);
+}
+
+//------ vertex arrays ------
+
+void glGenVertexArrays(GLsizei n, GLuint *arrays) {
+	gen_names(n, arrays);
+}
+void glDeleteVertexArrays(GLsizei, GLuint const *) {
+}
+void glBindVertexArray(GLuint) {
+	++null_gl_counts.vao_binds;
+}
+void glEnableVertexAttribArray(GLuint) {
+}
+void glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, void const *) {
+}
+void glVertexAttribDivisor(GLuint, GLuint) {
+}
+
+//------ programs ------
+
+//programs have no attributes, so MeshBuffer::make_vao_for_program binds nothing:
+void glGetProgramiv(GLuint, GLenum, GLint *params) {
+	*params = 0;
+}
+void glGetActiveAttrib(GLuint, GLuint, GLsizei buf_size, GLsizei *length, GLint *size, GLenum *type, GLchar *name) {
+	if (length) *length = 0;
+	*size = 0;
+	*type = GL_FLOAT;
+	if (buf_size > 0) name[0] = '\0';
+}
+GLint glGetAttribLocation(GLuint, GLchar const *) {
+	return -1;
+}
+void glUseProgram(GLuint) {
+	++null_gl_counts.program_binds;
+}
+void glUniform1f(GLint, GLfloat) {
+	++null_gl_counts.uniform_calls;
+}
+void glUniform3fv(GLint, GLsizei, GLfloat const *) {
+	++null_gl_counts.uniform_calls;
+}
+void glUniform4fv(GLint, GLsizei, GLfloat const *) {
+	++null_gl_counts.uniform_calls;
+}
+void glUniformMatrix3fv(GLint, GLsizei, GLboolean, GLfloat const *) {
+	++null_gl_counts.uniform_calls;
+}
+void glUniformMatrix4fv(GLint, GLsizei, GLboolean, GLfloat const *) {
+	++null_gl_counts.uniform_calls;
+}
+void glUniformMatrix4x3fv(GLint, GLsizei, GLboolean, GLfloat const *) {
+	++null_gl_counts.uniform_calls;
+}
+
+//------ drawing ------
+
+void glDrawArrays(GLenum, GLint, GLsizei) {
+	++null_gl_counts.draw_calls;
+}
+void glDrawArraysInstanced(GLenum, GLint, GLsizei, GLsizei instance_count) {
+	++null_gl_counts.draw_calls;
+	++null_gl_counts.instanced_draw_calls;
+	null_gl_counts.instances += uint64_t(instance_count);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+//"null_gl" defines the OpenGL entry points that Scene, MeshBuffer, and GLRenderDevice call as functions that do nothing but count,
+// so scene code can run (and be benchmarked -- see bench_scene.cpp) without a context or window.
+//Link it in place of the system OpenGL library. (Not for Windows, where entry points come from gl_shims.)
+//Generated names start at 1 and are never reused; queries return plausible constants.
+struct NullGLCounts {
+	uint64_t draw_calls = 0; //glDrawArrays + glDrawArraysInstanced
+	uint64_t instanced_draw_calls = 0;
+	uint64_t instances = 0; //drawn by instanced calls
+	uint64_t program_binds = 0;
+	uint64_t vao_binds = 0;
+	uint64_t buffer_binds = 0; //glBindBuffer + glBindBufferRange
+	uint64_t uniform_calls = 0;
+	uint64_t upload_calls = 0; //glBufferData + glBufferSubData
+	uint64_t upload_bytes = 0;
+};
+extern NullGLCounts null_gl_counts;
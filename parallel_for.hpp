@@ -0,0 +1,149 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+//"WorkerPool" keeps one thread per extra hardware thread asleep between jobs,
+// so parallel_for pays for waking workers (a few microseconds) instead of creating and joining threads every call.
+//The pool is shared (see WorkerPool::shared()) and started the first time a job is split.
+struct WorkerPool {
+	//a job is 'ranges' calls of run(fn, r), claimed one at a time by whichever threads get to them first:
+	struct Job {
+		void (*run)(void const *fn, uint32_t r) = nullptr;
+		void const *fn = nullptr;
+		uint32_t ranges = 0;
+		std::atomic< uint32_t > next{0}; //next range to claim
+		uint32_t done = 0; //ranges finished (guarded by mutex)
+		uint32_t users = 0; //workers holding a pointer to this job (guarded by mutex)
+	};
+
+	WorkerPool() {
+		uint32_t count = std::max(1U, std::thread::hardware_concurrency()) - 1;
+		workers.reserve(count);
+		for (uint32_t w = 0; w < count; ++w) {
+			workers.emplace_back([this](){ work(); });
+		}
+	}
+	~WorkerPool() {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for (auto &worker : workers) {
+			worker.join();
+		}
+	}
+	WorkerPool(WorkerPool const &) = delete;
+	WorkerPool &operator=(WorkerPool const &) = delete;
+
+	static WorkerPool &shared() {
+		static WorkerPool pool;
+		return pool;
+	}
+
+	//run every range of 'job', with the calling thread helping; returns once all ranges are done.
+	//(jobs may be started from inside other jobs: the caller only ever waits on ranges someone is already running)
+	void run(Job &job) {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			jobs.emplace_back(&job);
+		}
+		for (uint32_t w = 1; w < job.ranges; ++w) {
+			wake.notify_one();
+		}
+
+		uint32_t ran = claim(job);
+
+		std::unique_lock< std::mutex > lock(mutex);
+		jobs.erase(std::remove(jobs.begin(), jobs.end(), &job), jobs.end());
+		job.done += ran;
+		finished.wait(lock, [&job](){ return job.done == job.ranges && job.users == 0; });
+	}
+
+private:
+	//run ranges of 'job' until none are left; returns how many this thread ran:
+	static uint32_t claim(Job &job) {
+		uint32_t ran = 0;
+		for (uint32_t r = job.next++; r < job.ranges; r = job.next++) {
+			job.run(job.fn, r);
+			++ran;
+		}
+		return ran;
+	}
+
+	void work() {
+		std::unique_lock< std::mutex > lock(mutex);
+		while (true) {
+			Job *job = nullptr;
+			wake.wait(lock, [this, &job](){
+				for (Job *j : jobs) {
+					if (j->next.load() < j->ranges) {
+						job = j;
+						return true;
+					}
+				}
+				return quit;
+			});
+			if (!job) return;
+
+			++job->users;
+			lock.unlock();
+			uint32_t ran = claim(*job);
+			lock.lock();
+			job->done += ran;
+			--job->users;
+			if (job->done == job->ranges && job->users == 0) {
+				finished.notify_all();
+			}
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable wake; //workers wait here for jobs
+	std::condition_variable finished; //callers wait here for their jobs' last ranges
+	std::vector< Job * > jobs; //jobs that may still have unclaimed ranges
+	bool quit = false;
+	std::vector< std::thread > workers;
+};
+
+//"parallel_for" calls fn(begin, end) on contiguous ranges that together cover [0, count).
+// Ranges are spread over up to 'threads' threads (0 means one per hardware thread) from WorkerPool::shared(),
+// but each thread gets at least 'min_per_thread' items, so small counts just run on the calling thread.
+// The calling thread works on ranges too; returns once all ranges are done.
+//Handing ranges to sleeping workers costs a few microseconds per call, so 'min_per_thread' should be
+// enough work to hide that (more means less overhead but less parallelism on medium counts).
+template< typename F >
+void parallel_for(uint32_t count, uint32_t threads, uint32_t min_per_thread, F const &fn) {
+	if (threads == 0) {
+		threads = std::max(1U, std::thread::hardware_concurrency());
+	}
+	threads = std::min(threads, std::max(1U, count / std::max(1U, min_per_thread)));
+
+	if (threads <= 1) {
+		fn(0U, count);
+		return;
+	}
+
+	struct Ranges {
+		F const &fn;
+		uint32_t count;
+		uint32_t threads;
+	} ranges{fn, count, threads};
+
+	WorkerPool::Job job;
+	job.fn = &ranges;
+	job.ranges = threads;
+	job.run = [](void const *data, uint32_t r) {
+		Ranges const &ranges = *static_cast< Ranges const * >(data);
+		uint32_t begin = uint32_t(uint64_t(ranges.count) * r / ranges.threads);
+		uint32_t end = uint32_t(uint64_t(ranges.count) * (r + 1) / ranges.threads);
+		ranges.fn(begin, end);
+	};
+	WorkerPool::shared().run(job);
+}
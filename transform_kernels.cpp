@@ -0,0 +1,233 @@
+#include "transform_kernels.hpp"
+
+#include <cstddef>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORM_KERNELS_SSE
+#include <xmmintrin.h>
+#endif
+
+static_assert(sizeof(glm::quat) == 4 * 4 && offsetof(glm::quat, x) == 0 && offsetof(glm::quat, w) == 12, "kernels expect quaternions stored as x,y,z,w");
+static_assert(sizeof(glm::mat4) == 4 * 16, "kernels expect packed mat4s");
+
+//Both kernels run four transforms at a time; leftovers are padded out to a block of four,
+// so a single transform goes down exactly the same path as a batch (and gets exactly the same result).
+
+namespace {
+
+//four floats, one per transform in the block:
+struct Lanes {
+#ifdef TRANSFORM_KERNELS_SSE
+	__m128 v;
+#else
+	float v[4];
+#endif
+};
+
+#ifdef TRANSFORM_KERNELS_SSE
+inline Lanes splat(float f) { return Lanes{_mm_set1_ps(f)}; }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{_mm_add_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return Lanes{_mm_sub_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{_mm_mul_ps(a.v, b.v)}; }
+//1/s, or 0 where s is 0:
+inline Lanes safe_reciprocal(Lanes s) {
+	return Lanes{_mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), s.v), _mm_cmpneq_ps(s.v, _mm_setzero_ps()))};
+}
+#else
+inline Lanes splat(float f) { return Lanes{{f, f, f, f}}; }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{{a.v[0]+b.v[0], a.v[1]+b.v[1], a.v[2]+b.v[2], a.v[3]+b.v[3]}}; }
+inline Lanes operator-(Lanes a, Lanes b) { return Lanes{{a.v[0]-b.v[0], a.v[1]-b.v[1], a.v[2]-b.v[2], a.v[3]-b.v[3]}}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{{a.v[0]*b.v[0], a.v[1]*b.v[1], a.v[2]*b.v[2], a.v[3]*b.v[3]}}; }
+inline Lanes safe_reciprocal(Lanes s) {
+	Lanes ret;
+	for (uint32_t l = 0; l < 4; ++l) {
+		ret.v[l] = (s.v[l] == 0.0f ? 0.0f : 1.0f / s.v[l]);
+	}
+	return ret;
+}
+#endif
+
+//read one component of four vec3s into lanes:
+inline Lanes gather(glm::vec3 const *v[4], uint32_t c) {
+#ifdef TRANSFORM_KERNELS_SSE
+	return Lanes{_mm_setr_ps((*v[0])[c], (*v[1])[c], (*v[2])[c], (*v[3])[c])};
+#else
+	return Lanes{{(*v[0])[c], (*v[1])[c], (*v[2])[c], (*v[3])[c]}};
+#endif
+}
+
+//write column 'c' of four matrices from lanes holding its x, y, z (w is 'w'):
+inline void scatter(glm::mat4 *out[4], uint32_t c, Lanes x, Lanes y, Lanes z, float w) {
+#ifdef TRANSFORM_KERNELS_SSE
+	__m128 w4 = _mm_set1_ps(w);
+	_MM_TRANSPOSE4_PS(x.v, y.v, z.v, w4);
+	_mm_storeu_ps(&(*out[0])[c][0], x.v);
+	_mm_storeu_ps(&(*out[1])[c][0], y.v);
+	_mm_storeu_ps(&(*out[2])[c][0], z.v);
+	_mm_storeu_ps(&(*out[3])[c][0], w4);
+#else
+	for (uint32_t l = 0; l < 4; ++l) {
+		(*out[l])[c] = glm::vec4(x.v[l], y.v[l], z.v[l], w);
+	}
+#endif
+}
+
+//rotation matrix columns (r[column][row]) of four unit quaternions; same formula as glm::mat4_cast:
+inline void rotation_columns(glm::quat const *q[4], Lanes r[3][3]) {
+#ifdef TRANSFORM_KERNELS_SSE
+	Lanes x{_mm_loadu_ps(&q[0]->x)};
+	Lanes y{_mm_loadu_ps(&q[1]->x)};
+	Lanes z{_mm_loadu_ps(&q[2]->x)};
+	Lanes w{_mm_loadu_ps(&q[3]->x)};
+	_MM_TRANSPOSE4_PS(x.v, y.v, z.v, w.v);
+#else
+	Lanes x{{q[0]->x, q[1]->x, q[2]->x, q[3]->x}};
+	Lanes y{{q[0]->y, q[1]->y, q[2]->y, q[3]->y}};
+	Lanes z{{q[0]->z, q[1]->z, q[2]->z, q[3]->z}};
+	Lanes w{{q[0]->w, q[1]->w, q[2]->w, q[3]->w}};
+#endif
+	Lanes one = splat(1.0f);
+	Lanes two = splat(2.0f);
+	Lanes xx = x * x, yy = y * y, zz = z * z;
+	Lanes xy = x * y, xz = x * z, yz = y * z;
+	Lanes wx = w * x, wy = w * y, wz = w * z;
+
+	r[0][0] = one - two * (yy + zz);
+	r[0][1] = two * (xy + wz);
+	r[0][2] = two * (xz - wy);
+
+	r[1][0] = two * (xy - wz);
+	r[1][1] = one - two * (xx + zz);
+	r[1][2] = two * (yz + wx);
+
+	r[2][0] = two * (xz + wy);
+	r[2][1] = two * (yz - wx);
+	r[2][2] = one - two * (xx + yy);
+}
+
+void local_to_parent_block(glm::vec3 const *p[4], glm::quat const *q[4], glm::vec3 const *s[4], glm::mat4 *out[4]) {
+	Lanes r[3][3];
+	rotation_columns(q, r);
+
+	//each rotation column scaled by the matching scale component:
+	for (uint32_t c = 0; c < 3; ++c) {
+		Lanes sc = gather(s, c);
+		scatter(out, c, r[c][0] * sc, r[c][1] * sc, r[c][2] * sc, 0.0f);
+	}
+	scatter(out, 3, gather(p, 0), gather(p, 1), gather(p, 2), 1.0f);
+}
+
+void parent_to_local_block(glm::vec3 const *p[4], glm::quat const *q[4], glm::vec3 const *s[4], glm::mat4 *out[4]) {
+	Lanes r[3][3];
+	rotation_columns(q, r);
+
+	Lanes inv_s[3] = {
+		safe_reciprocal(gather(s, 0)),
+		safe_reciprocal(gather(s, 1)),
+		safe_reciprocal(gather(s, 2)),
+	};
+
+	//un-scale * transpose(rotation): column c is row c of the rotation, scaled per component:
+	Lanes m[3][3];
+	for (uint32_t c = 0; c < 3; ++c) {
+		m[c][0] = inv_s[0] * r[0][c];
+		m[c][1] = inv_s[1] * r[1][c];
+		m[c][2] = inv_s[2] * r[2][c];
+		scatter(out, c, m[c][0], m[c][1], m[c][2], 0.0f);
+	}
+
+	//un-translate, carried through the above:
+	Lanes px = gather(p, 0), py = gather(p, 1), pz = gather(p, 2);
+	Lanes zero = splat(0.0f);
+	scatter(out, 3,
+		zero - (m[0][0] * px + m[1][0] * py + m[2][0] * pz),
+		zero - (m[0][1] * px + m[1][1] * py + m[2][1] * pz),
+		zero - (m[0][2] * px + m[1][2] * py + m[2][2] * pz),
+		1.0f
+	);
+}
+
+typedef void (*Block)(glm::vec3 const *p[4], glm::quat const *q[4], glm::vec3 const *s[4], glm::mat4 *out[4]);
+
+//run 'block' over all transforms, padding the last block with identity transforms:
+void run_blocks(uint32_t count, uint32_t const *indices, glm::vec3 const *positions, glm::quat const *rotations, glm::vec3 const *scales, glm::mat4 *out, Block block) {
+	static glm::vec3 const pad_position = glm::vec3(0.0f);
+	static glm::quat const pad_rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	static glm::vec3 const pad_scale = glm::vec3(1.0f);
+	glm::mat4 pad_out;
+
+	for (uint32_t i = 0; i < count; i += 4) {
+		glm::vec3 const *p[4];
+		glm::quat const *q[4];
+		glm::vec3 const *s[4];
+		glm::mat4 *o[4];
+		for (uint32_t l = 0; l < 4; ++l) {
+			if (i + l < count) {
+				uint32_t index = (indices ? indices[i + l] : i + l);
+				p[l] = positions + index;
+				q[l] = rotations + index;
+				s[l] = scales + index;
+				o[l] = out + i + l;
+			} else {
+				p[l] = &pad_position;
+				q[l] = &pad_rotation;
+				s[l] = &pad_scale;
+				o[l] = &pad_out;
+			}
+		}
+		block(p, q, s, o);
+	}
+}
+
+} //end anon namespace
+
+void make_local_to_parent(uint32_t count, glm::vec3 const *positions, glm::quat const *rotations, glm::vec3 const *scales, glm::mat4 *local_to_parent, uint32_t const *indices) {
+	run_blocks(count, indices, positions, rotations, scales, local_to_parent, local_to_parent_block);
+}
+
+void make_parent_to_local(uint32_t count, glm::vec3 const *positions, glm::quat const *rotations, glm::vec3 const *scales, glm::mat4 *parent_to_local, uint32_t const *indices) {
+	run_blocks(count, indices, positions, rotations, scales, parent_to_local, parent_to_local_block);
+}
+
+glm::mat4 multiply_affine(glm::mat4 const &a, glm::mat4 const &b) {
+	glm::mat4 ret;
+#ifdef TRANSFORM_KERNELS_SSE
+	__m128 a0 = _mm_loadu_ps(&a[0][0]);
+	__m128 a1 = _mm_loadu_ps(&a[1][0]);
+	__m128 a2 = _mm_loadu_ps(&a[2][0]);
+	__m128 a3 = _mm_loadu_ps(&a[3][0]);
+	for (uint32_t c = 0; c < 4; ++c) {
+		__m128 col = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(a0, _mm_set1_ps(b[c][0])),
+			_mm_mul_ps(a1, _mm_set1_ps(b[c][1]))),
+			_mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+		if (c == 3) col = _mm_add_ps(col, a3);
+		_mm_storeu_ps(&ret[c][0], col);
+	}
+#else
+	for (uint32_t c = 0; c < 4; ++c) {
+		ret[c] = a[0] * b[c][0] + a[1] * b[c][1] + a[2] * b[c][2];
+		if (c == 3) ret[c] += a[3];
+	}
+#endif
+	return ret;
+}
+
+glm::mat3 make_normal_matrix(glm::mat4 const &local_to_world) {
+	glm::mat3 m = glm::mat3(local_to_world);
+
+	//rotation + uniform scale? then the inverse transpose is m / scale^2:
+	float l0 = glm::dot(m[0], m[0]);
+	float tolerance = 1e-5f * l0;
+	if (l0 > 0.0f
+	 && std::abs(glm::dot(m[1], m[1]) - l0) <= tolerance
+	 && std::abs(glm::dot(m[2], m[2]) - l0) <= tolerance
+	 && std::abs(glm::dot(m[0], m[1])) <= tolerance
+	 && std::abs(glm::dot(m[0], m[2])) <= tolerance
+	 && std::abs(glm::dot(m[1], m[2])) <= tolerance) {
+		return m * (1.0f / l0);
+	}
+
+	return glm::inverse(glm::transpose(m));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+
+//Batched kernels for building transform matrices (used by Scene; see bench_transforms.cpp for timings).
+//These compute the affine matrices directly from position/rotation/scale -- no intermediate matrix products --
+// and work on four transforms at a time with SSE when it is available.
+//Matrices are affine (bottom row 0,0,0,1) but stored as mat4 so each column is a 16-byte vector.
+//Rotations are assumed to be unit quaternions (as glm::mat4_cast assumes).
+
+//translate * rotate * scale, for 'count' transforms:
+// output k is built from input element indices[k] (or element k, if 'indices' is null)
+void make_local_to_parent(uint32_t count, glm::vec3 const *positions, glm::quat const *rotations, glm::vec3 const *scales, glm::mat4 *local_to_parent, uint32_t const *indices = nullptr);
+
+//inverse of the above: un-scale * un-rotate * un-translate (zero scales invert to zero):
+void make_parent_to_local(uint32_t count, glm::vec3 const *positions, glm::quat const *rotations, glm::vec3 const *scales, glm::mat4 *parent_to_local, uint32_t const *indices = nullptr);
+
+//product of two affine matrices (ignores their bottom rows):
+glm::mat4 multiply_affine(glm::mat4 const &a, glm::mat4 const &b);
+
+//inverse transpose of the upper 3x3 of 'local_to_world', for transforming normals:
+// when the columns are orthogonal and of equal length (rotation + uniform scale), this is just the matrix
+// divided by its squared scale, so the general inverse is skipped.
+glm::mat3 make_normal_matrix(glm::mat4 const &local_to_world);
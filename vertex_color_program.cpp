@@ -1,6 +1,57 @@
 #include "vertex_color_program.hpp"
 
 #include "compile_program.hpp"
+#include "Scene.hpp"
+
+//lighting is shared by all variants of the program, but may come from uniforms or the "Frame" block:
+static char const *lighting_uniforms =
+	"uniform vec3 sun_direction;\n"
+	"uniform vec3 sun_color;\n"
+	"uniform vec3 sky_direction;\n"
+	"uniform vec3 sky_color;\n";
+
+//matches Scene::FrameBlock (std140 pads each vec3 to 16 bytes):
+static char const *frame_block =
+	"layout(std140) uniform Frame {\n"
+	"	mat4 world_to_clip;\n"
+	"	vec3 sun_direction;\n"
+	"	vec3 sun_color;\n"
+	"	vec3 sky_direction;\n"
+	"	vec3 sky_color;\n"
+	"};\n";
+
+static char const *fragment_main =
+	"in vec3 position;\n"
+	"in vec3 normal;\n"
+	"in vec4 color;\n"
+	"out vec4 fragColor;\n"
+	"void main() {\n"
+	"	vec3 total_light = vec3(0.0, 0.0, 0.0);\n"
+	"	vec3 n = normalize(normal);\n"
+	"	{ //sky (hemisphere) light:\n"
+	"		vec3 l = sky_direction;\n"
+	"		float nl = 0.5 + 0.5 * dot(n,l);\n"
+	"		total_light += nl * sky_color;\n"
+	"	}\n"
+	"	{ //sun (directional) light:\n"
+	"		vec3 l = sun_direction;\n"
+	"		float nl = max(0.0, dot(n,l));\n"
+	"		total_light += nl * sun_color;\n"
+	"	}\n"
+	"	fragColor = vec4(color.rgb * total_light, color.a);\n"
+	"}\n";
+
+//point a program's "Frame" and "Object" blocks (if present) at the bindings Scene::draw() uses:
+static void bind_scene_blocks(GLuint program) {
+	GLuint frame_index = glGetUniformBlockIndex(program, "Frame");
+	if (frame_index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, frame_index, Scene::FrameBlockBinding);
+	}
+	GLuint object_index = glGetUniformBlockIndex(program, "Object");
+	if (object_index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, object_index, Scene::ObjectBlockBinding);
+	}
+}
 
 VertexColorProgram::VertexColorProgram() {
 	program = compile_program(
@@ -21,30 +72,7 @@ VertexColorProgram::VertexColorProgram() {
 		"	color = Color;\n"
 		"}\n"
 		,
-		"#version 330\n"
-		"uniform vec3 sun_direction;\n"
-		"uniform vec3 sun_color;\n"
-		"uniform vec3 sky_direction;\n"
-		"uniform vec3 sky_color;\n"
-		"in vec3 position;\n"
-		"in vec3 normal;\n"
-		"in vec4 color;\n"
-		"out vec4 fragColor;\n"
-		"void main() {\n"
-		"	vec3 total_light = vec3(0.0, 0.0, 0.0);\n"
-		"	vec3 n = normalize(normal);\n"
-		"	{ //sky (hemisphere) light:\n"
-		"		vec3 l = sky_direction;\n"
-		"		float nl = 0.5 + 0.5 * dot(n,l);\n"
-		"		total_light += nl * sky_color;\n"
-		"	}\n"
-		"	{ //sun (directional) light:\n"
-		"		vec3 l = sun_direction;\n"
-		"		float nl = max(0.0, dot(n,l));\n"
-		"		total_light += nl * sun_color;\n"
-		"	}\n"
-		"	fragColor = vec4(color.rgb * total_light, color.a);\n"
-		"}\n"
+		std::string("#version 330\n") + lighting_uniforms + fragment_main
 	);
 
 	object_to_clip_mat4 = glGetUniformLocation(program, "object_to_clip");
@@ -60,3 +88,63 @@ VertexColorProgram::VertexColorProgram() {
 Load< VertexColorProgram > vertex_color_program(LoadTagInit, [](){
 	return new VertexColorProgram();
 });
+
+VertexColorBlockProgram::VertexColorBlockProgram() {
+	program = compile_program(
+		"#version 330\n"
+		"layout(std140) uniform Object {\n" //matches Scene::ObjectBlock
+		"	mat4 object_to_clip;\n"
+		"	mat4 object_to_light;\n"
+		"	mat4 normal_to_light;\n"
+		"};\n"
+		"layout(location=0) in vec4 Position;\n"
+		"in vec3 Normal;\n"
+		"in vec4 Color;\n"
+		"out vec3 position;\n"
+		"out vec3 normal;\n"
+		"out vec4 color;\n"
+		"void main() {\n"
+		"	gl_Position = object_to_clip * Position;\n"
+		"	position = vec3(object_to_light * Position);\n"
+		"	normal = mat3(normal_to_light) * Normal;\n"
+		"	color = Color;\n"
+		"}\n"
+		,
+		std::string("#version 330\n") + frame_block + fragment_main
+	);
+
+	bind_scene_blocks(program);
+}
+
+Load< VertexColorBlockProgram > vertex_color_block_program(LoadTagInit, [](){
+	return new VertexColorBlockProgram();
+});
+
+VertexColorInstancedProgram::VertexColorInstancedProgram() {
+	program = compile_program(
+		"#version 330\n"
+		"layout(location=0) in vec4 Position;\n"
+		"in vec3 Normal;\n"
+		"in vec4 Color;\n"
+		"in mat4 ObjectToClip;\n" //per-instance
+		"in mat4x3 ObjectToLight;\n" //per-instance
+		"in mat3 NormalToLight;\n" //per-instance
+		"out vec3 position;\n"
+		"out vec3 normal;\n"
+		"out vec4 color;\n"
+		"void main() {\n"
+		"	gl_Position = ObjectToClip * Position;\n"
+		"	position = ObjectToLight * Position;\n"
+		"	normal = NormalToLight * Normal;\n"
+		"	color = Color;\n"
+		"}\n"
+		,
+		std::string("#version 330\n") + frame_block + fragment_main
+	);
+
+	bind_scene_blocks(program);
+}
+
+Load< VertexColorInstancedProgram > vertex_color_instanced_program(LoadTagInit, [](){
+	return new VertexColorInstancedProgram();
+});
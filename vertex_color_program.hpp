@@ -18,3 +18,26 @@ struct VertexColorProgram {
 };
 
 extern Load< VertexColorProgram > vertex_color_program;
+
+//Uniform-block variant: reads matrices from the "Object" block and lighting from the "Frame" block
+// (bound to Scene::ObjectBlockBinding and Scene::FrameBlockBinding -- see Scene::ObjectBlock and Scene::FrameBlock):
+struct VertexColorBlockProgram {
+	//opengl program object:
+	GLuint program = 0;
+
+	VertexColorBlockProgram();
+};
+
+extern Load< VertexColorBlockProgram > vertex_color_block_program;
+
+//Instanced variant: reads the object-to-clip, object-to-light, and normal-to-light matrices
+// as per-instance attributes (ObjectToClip, ObjectToLight, NormalToLight -- see Scene::instance_attribs())
+// and lighting from the "Frame" block:
+struct VertexColorInstancedProgram {
+	//opengl program object:
+	GLuint program = 0;
+
+	VertexColorInstancedProgram();
+};
+
+extern Load< VertexColorInstancedProgram > vertex_color_instanced_program;